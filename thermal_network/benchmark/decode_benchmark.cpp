@@ -0,0 +1,354 @@
+/// \file Decode benchmarks
+/// \brief Throughput of reassembly, every decode kernel set, the colormap and the encoders
+///
+/// Usage: decode_benchmark [benchmark flags] [capture [sensor [telemetry]]]
+///
+/// The capture is a recording of the node, see segment_recording.hpp, or a file of back to
+/// back segments as the sender puts them on the wire, only the first camera of a recording is
+/// used. Without a capture, or with - as capture, a synthetic scene is used, a warm spot on a
+/// gradient with sensor noise. Sensor and telemetry select the layout like the node parameters
+/// of the same name, lepton3.1r without telemetry by default. Every benchmark reports frames per
+/// second and nanoseconds per pixel.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "thermal_network/colormap.hpp"
+#include "thermal_network/decode_kernels.hpp"
+#include "thermal_network/frame_assembler.hpp"
+#include "thermal_network/frame_decoder.hpp"
+#include "thermal_network/histogram_agc.hpp"
+#include "thermal_network/image_encoder.hpp"
+#include "thermal_network/segment_recording.hpp"
+
+namespace thermal_network
+{
+
+namespace
+{
+/// \brief Layout of the segments, index into kSensorGeometries
+std::size_t g_geometry = kDefaultSensorGeometry;
+/// \brief Segments in arrival order, only the first segment_bytes() of each are used
+std::vector<std::array<uint8_t, kSegmentBytes>> g_segments;
+/// \brief The same frames reassembled and decoded
+std::vector<Frame> g_frames;
+std::vector<RawFrame> g_raw_frames;
+
+void set_counters(benchmark::State & state, std::size_t frames_per_iteration)
+{
+  const double frames = static_cast<double>(state.iterations() * frames_per_iteration);
+  state.counters["fps"] = benchmark::Counter(frames, benchmark::Counter::kIsRate);
+  // The inverse of a rate of billions of pixels per second is nanoseconds per pixel
+  state.counters["ns_per_pixel"] = benchmark::Counter(
+    frames * kSensorGeometries[g_geometry].pixels() * 1e-9,
+    benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+/// \brief Writes one synthetic frame as the segments the sender would put on the wire
+void synthesize_frame(uint32_t & seed, std::size_t frame_number)
+{
+  const SensorGeometry & geometry = kSensorGeometries[g_geometry];
+  const std::size_t spot_x = geometry.width / 4 + frame_number * 7 % (geometry.width / 2);
+  const std::size_t spot_y = geometry.height / 4 + frame_number * 5 % (geometry.height / 2);
+  const std::size_t first_video_packet = geometry.video_offset() / kPacketBytes;
+  for (std::size_t s = 0; s < geometry.segments; ++s) {
+    std::array<uint8_t, kSegmentBytes> segment{};
+    for (std::size_t p = 0; p < geometry.packets_per_segment; ++p) {
+      uint8_t * packet = segment.data() + p * kPacketBytes;
+      // Only packet 20 carries the segment number in its ID word
+      const unsigned int id = (p == 20 && geometry.segments > 1 ? (s + 1) << 12 : 0) | p;
+      packet[0] = id >> 8;
+      packet[1] = id & 0xFF;
+      const std::size_t frame_packet = s * geometry.packets_per_segment + p;
+      if (frame_packet < first_video_packet ||
+        frame_packet >= first_video_packet + geometry.video_packets())
+      {
+        continue;  // Telemetry stays zero
+      }
+      const std::size_t first = (frame_packet - first_video_packet) * kPacketPixels;
+      for (std::size_t w = 0; w < kPacketPixels; ++w) {
+        const std::size_t x = (first + w) % geometry.width;
+        const std::size_t y = (first + w) / geometry.width;
+        const std::size_t dx = x > spot_x ? x - spot_x : spot_x - x;
+        const std::size_t dy = y > spot_y ? y - spot_y : spot_y - y;
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t value = 29300 + x * 4 + y * 2 + (seed >> 28);
+        if (dx * dx + dy * dy < 100) {
+          value += 1500;
+        }
+        packet[(kPacketHeaderWords + w) * 2] = value >> 8;
+        packet[(kPacketHeaderWords + w) * 2 + 1] = value & 0xFF;
+      }
+    }
+    g_segments.push_back(segment);
+  }
+}
+
+/// \brief Reads the full-size segments of a capture, those of incomplete frames included
+bool load_capture(const std::string & path)
+{
+  const std::size_t segment_bytes = kSensorGeometries[g_geometry].segment_bytes();
+  SegmentReplay replay;
+  if (replay.open(path)) {
+    SegmentRecord record;
+    while (replay.next(record)) {
+      if (record.stream == 0 && record.size == segment_bytes && !record.truncated) {
+        g_segments.emplace_back();
+        std::copy(record.data, record.data + segment_bytes, g_segments.back().begin());
+      }
+    }
+    return true;
+  }
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), {});
+  for (std::size_t offset = 0; offset + segment_bytes <= data.size(); offset += segment_bytes) {
+    g_segments.emplace_back();
+    std::copy(&data[offset], &data[offset] + segment_bytes, g_segments.back().begin());
+  }
+  return true;
+}
+
+/// \brief Reassembles and decodes the segments once, the input of the later stages
+void prepare_frames()
+{
+  const std::size_t segment_bytes = kSensorGeometries[g_geometry].segment_bytes();
+  FrameAssembler assembler(INT64_MAX, g_geometry);
+  Frame frame;
+  for (const auto & segment : g_segments) {
+    if (assembler.add(segment.data(), segment_bytes, 0, 0, frame)) {
+      g_frames.push_back(frame);
+      g_raw_frames.emplace_back();
+      decode_frame(frame, g_raw_frames.back());
+    }
+  }
+}
+
+void BM_Reassemble(benchmark::State & state)
+{
+  const std::size_t segment_bytes = kSensorGeometries[g_geometry].segment_bytes();
+  FrameAssembler assembler(INT64_MAX, g_geometry);
+  Frame frame;
+  for (auto _ : state) {
+    for (const auto & segment : g_segments) {
+      benchmark::DoNotOptimize(assembler.add(segment.data(), segment_bytes, 0, 0, frame));
+    }
+    benchmark::ClobberMemory();
+  }
+  set_counters(state, g_frames.size());
+}
+
+void BM_DecodeFrame(benchmark::State & state, const DecodeKernels * kernels)
+{
+  RawFrame raw;
+  for (auto _ : state) {
+    for (const Frame & frame : g_frames) {
+      kernels->decode_frame[frame.geometry](frame, raw);
+      benchmark::DoNotOptimize(raw);
+    }
+  }
+  set_counters(state, g_frames.size());
+}
+
+void BM_Normalize(benchmark::State & state, const DecodeKernels * kernels)
+{
+  std::vector<uint8_t> index(kFramePixels);
+  for (auto _ : state) {
+    for (const RawFrame & raw : g_raw_frames) {
+      kernels->normalize(
+        raw.pixels.data(), raw.size(), raw.min, raw.max, 255.0f / (raw.max - raw.min),
+        index.data());
+      benchmark::DoNotOptimize(index.data());
+    }
+  }
+  set_counters(state, g_raw_frames.size());
+}
+
+void BM_ToCelsius(benchmark::State & state, const DecodeKernels * kernels)
+{
+  std::vector<float> celsius(kFramePixels);
+  for (auto _ : state) {
+    for (const RawFrame & raw : g_raw_frames) {
+      kernels->to_celsius(raw.pixels.data(), raw.size(), celsius.data());
+      benchmark::DoNotOptimize(celsius.data());
+    }
+  }
+  set_counters(state, g_raw_frames.size());
+}
+
+void BM_Calibrate(benchmark::State & state, const DecodeKernels * kernels)
+{
+  // Close to unity like a real table, so the values stay in range
+  std::vector<float> gain(kFramePixels);
+  std::vector<float> offset(kFramePixels);
+  for (std::size_t i = 0; i < kFramePixels; ++i) {
+    gain[i] = 1.0f + (i % 7) * 0.001f;
+    offset[i] = (i % 11) * 1.5f - 7.0f;
+  }
+  RawFrame calibrated;
+  for (auto _ : state) {
+    for (const RawFrame & raw : g_raw_frames) {
+      calibrated.pixels = raw.pixels;
+      kernels->calibrate(calibrated.pixels.data(), raw.size(), gain.data(), offset.data());
+      benchmark::DoNotOptimize(calibrated.pixels.data());
+    }
+  }
+  set_counters(state, g_raw_frames.size());
+}
+
+/// \brief Colorizing through the raw value to color table, rebuilt for every frame's range
+void BM_ColorizeLut(benchmark::State & state)
+{
+  ColormapLut colormap;
+  std::vector<uint8_t> rgb(kFramePixels * 3);
+  for (auto _ : state) {
+    for (const RawFrame & raw : g_raw_frames) {
+      colormap.set_range(raw.min, raw.max, 255.0f / (raw.max - raw.min));
+      colormap.colorize(raw.pixels.data(), raw.size(), rgb.data());
+      benchmark::DoNotOptimize(rgb.data());
+    }
+  }
+  set_counters(state, g_raw_frames.size());
+}
+
+/// \brief Colorizing through normalize() and the palette, without a table
+void BM_ColorizeDirect(benchmark::State & state, const DecodeKernels * kernels)
+{
+  const PaletteColors & colors = palette_colors(Palette::kIronblack);
+  std::vector<uint8_t> index(kFramePixels);
+  std::vector<uint8_t> rgb(kFramePixels * 3);
+  for (auto _ : state) {
+    for (const RawFrame & raw : g_raw_frames) {
+      kernels->normalize(
+        raw.pixels.data(), raw.size(), raw.min, raw.max, 255.0f / (raw.max - raw.min),
+        index.data());
+      for (std::size_t i = 0; i < raw.size(); ++i) {
+        rgb[i * 3] = colors[index[i] * 3];
+        rgb[i * 3 + 1] = colors[index[i] * 3 + 1];
+        rgb[i * 3 + 2] = colors[index[i] * 3 + 2];
+      }
+      benchmark::DoNotOptimize(rgb.data());
+    }
+  }
+  set_counters(state, g_raw_frames.size());
+}
+
+void BM_HistogramAgc(benchmark::State & state)
+{
+  HistogramAgc agc(0.5);
+  ColormapLut colormap;
+  std::vector<uint8_t> mapping;
+  std::vector<uint8_t> rgb(kFramePixels * 3);
+  for (auto _ : state) {
+    for (const RawFrame & raw : g_raw_frames) {
+      uint16_t first;
+      agc.equalize(raw, first, mapping);
+      colormap.set_mapping(first, mapping);
+      colormap.colorize(raw.pixels.data(), raw.size(), rgb.data());
+      benchmark::DoNotOptimize(rgb.data());
+    }
+  }
+  set_counters(state, g_raw_frames.size());
+}
+
+void BM_Encode(benchmark::State & state, ImageCodec codec, int quality)
+{
+  const PaletteColors & colors = palette_colors(Palette::kIronblack);
+  std::vector<std::vector<uint8_t>> indices;
+  for (const RawFrame & raw : g_raw_frames) {
+    indices.emplace_back(kFramePixels);
+    active_decode_kernels().normalize(
+      raw.pixels.data(), raw.size(), raw.min, raw.max, 255.0f / (raw.max - raw.min),
+      indices.back().data());
+  }
+  std::vector<uint8_t> out;
+  std::size_t bytes = 0;
+  for (auto _ : state) {
+    for (const auto & index : indices) {
+      const RawFrame & raw = g_raw_frames.front();
+      if (!encode_image(codec, index.data(), raw.width, raw.height, colors, quality, out)) {
+        state.SkipWithError("Encoding failed");
+        return;
+      }
+      bytes += out.size();
+    }
+  }
+  set_counters(state, indices.size());
+  state.counters["bytes_per_frame"] =
+    static_cast<double>(bytes) / static_cast<double>(state.iterations() * indices.size());
+}
+}  // namespace
+
+}  // namespace thermal_network
+
+int main(int argc, char ** argv)
+{
+  using namespace thermal_network;  // NOLINT(build/namespaces)
+
+  benchmark::Initialize(&argc, argv);
+  if (argc > 2 &&
+    !find_sensor_geometry(argv[2], argc > 3 ? argv[3] : "none", g_geometry))
+  {
+    fprintf(stderr, "Unknown sensor %s\n", argv[2]);
+    return 1;
+  }
+  if (argc > 1 && std::string(argv[1]) != "-") {
+    if (!load_capture(argv[1])) {
+      fprintf(stderr, "Cannot read capture %s\n", argv[1]);
+      return 1;
+    }
+  } else {
+    uint32_t seed = 1;
+    for (std::size_t i = 0; i < 16; ++i) {
+      synthesize_frame(seed, i);
+    }
+  }
+  prepare_frames();
+  if (g_frames.empty()) {
+    fprintf(stderr, "The capture holds no complete frame\n");
+    return 1;
+  }
+
+  benchmark::RegisterBenchmark("reassemble", BM_Reassemble);
+  for (const char * name : {"scalar", "sse4.1", "avx2", "neon"}) {
+    const DecodeKernels * kernels = find_decode_kernels(name);
+    if (kernels == nullptr) {
+      continue;
+    }
+    benchmark::RegisterBenchmark(
+      (std::string("decode_frame/") + name).c_str(), BM_DecodeFrame, kernels);
+    benchmark::RegisterBenchmark(
+      (std::string("normalize/") + name).c_str(), BM_Normalize, kernels);
+    benchmark::RegisterBenchmark(
+      (std::string("to_celsius/") + name).c_str(), BM_ToCelsius, kernels);
+    benchmark::RegisterBenchmark(
+      (std::string("calibrate/") + name).c_str(), BM_Calibrate, kernels);
+    benchmark::RegisterBenchmark(
+      (std::string("colorize/direct/") + name).c_str(), BM_ColorizeDirect, kernels);
+  }
+  benchmark::RegisterBenchmark("colorize/lut", BM_ColorizeLut);
+  benchmark::RegisterBenchmark("colorize/histogram_agc", BM_HistogramAgc);
+  for (const char * name : {"png", "qoi", "jpeg"}) {
+    ImageCodec codec;
+    if (parse_image_codec(name, codec)) {
+      const int quality = codec == ImageCodec::kJpeg ? 90 : 6;
+      benchmark::RegisterBenchmark(
+        (std::string("encode/") + name).c_str(), BM_Encode, codec, quality);
+    }
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
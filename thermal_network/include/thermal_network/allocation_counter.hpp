@@ -0,0 +1,25 @@
+/// \file Heap allocation counting
+/// \brief Per-thread count of operator new calls, when the counting library is preloaded
+///
+/// libthermal_network_allocation_counter.so, built with THERMAL_NETWORK_ALLOCATION_COUNTER,
+/// replaces the global operator new and counts the calls of each thread. It has to be loaded
+/// with LD_PRELOAD, a replacement inside the dlopen'ed component would not see the allocations of
+/// the rest of the process. Without it counting is simply not available and costs nothing.
+
+#ifndef THERMAL_NETWORK__ALLOCATION_COUNTER_HPP_
+#define THERMAL_NETWORK__ALLOCATION_COUNTER_HPP_
+
+#include <cstdint>
+
+namespace thermal_network
+{
+
+/// \brief Whether the counting library is loaded
+bool allocation_counting_available();
+
+/// \brief Number of heap allocations of the calling thread so far, 0 without the library
+uint64_t thread_allocations();
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__ALLOCATION_COUNTER_HPP_
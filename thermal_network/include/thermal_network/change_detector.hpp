@@ -0,0 +1,78 @@
+/// \file Scene change detection
+/// \brief Block based comparison of decoded frames against the last published one
+///
+/// The frame is divided into square blocks and only the sum of each block is kept, which takes
+/// one sweep over the decoded buffer and a few hundred integers per frame. Comparing block
+/// means instead of pixels ignores sensor noise, which averages out over a block, while a
+/// person walking into the view moves the blocks it covers by far more than the threshold.
+
+#ifndef THERMAL_NETWORK__CHANGE_DETECTOR_HPP_
+#define THERMAL_NETWORK__CHANGE_DETECTOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "thermal_network/frame_decoder.hpp"
+
+namespace thermal_network
+{
+
+class ChangeDetector
+{
+/// \brief Tells whether a frame differs from the reference frame
+
+public:
+  struct Options
+  {
+    /// \brief Width and height of a block in pixels, edge blocks may be smaller
+    std::size_t block_size = 8;
+    /// \brief Change of the mean of a block in centikelvin that counts the block as changed
+    uint16_t threshold = 50;
+    /// \brief Number of changed blocks that make the frame changed
+    std::size_t min_blocks = 1;
+  };
+
+  /// \brief Allocates the block sums
+  /// \param options Detection settings
+  /// \param width Width of the frames
+  /// \param height Height of the frames
+  ChangeDetector(const Options & options, std::size_t width, std::size_t height);
+
+  /// \brief Computes the blocks of a frame and compares them against the reference
+  ///
+  /// Without a reference every frame counts as changed.
+  /// \param raw Decoded frame of the size given to the constructor
+  /// \return Whether at least min_blocks blocks changed
+  bool compare(const RawFrame & raw);
+
+  /// \brief Makes the frame given to the last compare() the reference
+  void update_reference();
+
+  /// \brief Forgets the reference, so the next frame counts as changed
+  void reset() {has_reference_ = false;}
+
+  /// \brief Number of blocks that changed in the last compare()
+  std::size_t changed_blocks() const {return changed_blocks_;}
+
+  /// \brief Largest change of a block mean in the last compare(), in centikelvin
+  double max_delta() const {return max_delta_;}
+
+private:
+  Options options_;
+  std::size_t columns_;
+  std::size_t rows_;
+  std::size_t width_;
+  std::size_t height_;
+  std::vector<uint32_t> sums_;
+  std::vector<uint32_t> reference_;
+  /// \brief Number of pixels of each block
+  std::vector<uint32_t> areas_;
+  bool has_reference_ = false;
+  std::size_t changed_blocks_ = 0;
+  double max_delta_ = 0.0;
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__CHANGE_DETECTOR_HPP_
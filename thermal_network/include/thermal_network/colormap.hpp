@@ -0,0 +1,88 @@
+/// \file Colormap rendering
+/// \brief Palettes and a lookup table from raw values straight to RGB8 pixels
+///
+/// The table covers the current range and is rebuilt lazily, only when the range or the
+/// palette changes. Colorizing is then one clamp and one table load per pixel.
+
+#ifndef THERMAL_NETWORK__COLORMAP_HPP_
+#define THERMAL_NETWORK__COLORMAP_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace thermal_network
+{
+
+/// \brief Palettes the colormap can render with
+enum class Palette
+{
+  kIronblack,
+  kRainbow,
+  kGrayscale,
+};
+
+/// \brief 256 colors as RGB8 byte triplets, index 0 is the cold end
+using PaletteColors = std::array<uint8_t, 256 * 3>;
+
+/// \brief Parses ironblack, rainbow or grayscale
+/// \return false when the name is unknown
+bool parse_palette(const std::string & name, Palette & palette);
+
+/// \brief Colors of a palette
+const PaletteColors & palette_colors(Palette palette);
+
+class ColormapLut
+{
+/// \brief Renders raw frames to RGB8 through a raw value to color table
+
+public:
+  /// \brief Selects the palette, the table is rebuilt on the next colorize() if it changed
+  void set_palette(Palette palette);
+
+  /// \brief Sets the range mapped onto the palette, see normalize() for the exact mapping
+  void set_range(uint16_t min, uint16_t max, float scale);
+
+  /// \brief Maps raw values through an explicit table of palette indices instead of a range
+  ///
+  /// Raw value first + i gets index[i], values outside of the table take the color of the
+  /// nearest end. set_range() switches back to the linear mapping.
+  /// \param first Raw value of the first entry
+  /// \param index Palette index of each raw value, at least one entry
+  void set_mapping(uint16_t first, const std::vector<uint8_t> & index);
+
+  /// \brief Writes count RGB8 pixels for count raw values
+  void colorize(const uint16_t * raw, std::size_t count, uint8_t * rgb);
+
+  /// \brief Writes the palette index of count raw values with the current range or mapping
+  void indices(const uint16_t * raw, std::size_t count, uint8_t * index) const;
+
+  /// \brief Palette in use
+  Palette palette() const {return palette_;}
+
+private:
+  Palette palette_ = Palette::kIronblack;
+  uint16_t min_ = 0;
+  uint16_t max_ = 0;
+  float scale_ = 0.0f;
+  bool dirty_ = true;
+  /// \brief Whether mapping_ replaces the linear range
+  bool mapped_ = false;
+  std::vector<uint8_t> mapping_;
+
+  /// \brief Highest raw value with its own table entry, values above share its color
+  uint16_t top_ = 0;
+  /// \brief Color of raw value min_ + i packed as 0x00BBGGRR
+  std::vector<uint32_t> table_;
+  /// \brief Scratch space for building the table and for the 8 bit path
+  std::vector<uint16_t> values_;
+  std::vector<uint8_t> index_;
+
+  void rebuild();
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__COLORMAP_HPP_
@@ -0,0 +1,97 @@
+/// \file Background image compression
+/// \brief Encodes and publishes sensor_msgs::msg::CompressedImage on a thread of its own
+///
+/// The worker only hands over the palette indices of a frame, a copy of 19200 bytes, and goes
+/// on with the next frame. When the encoder is still busy the frame waiting for it is replaced,
+/// so a slow codec lowers the rate of the compressed topic and nothing else.
+
+#ifndef THERMAL_NETWORK__COMPRESSED_PUBLISHER_HPP_
+#define THERMAL_NETWORK__COMPRESSED_PUBLISHER_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_lifecycle/lifecycle_node.hpp"
+#include "sensor_msgs/msg/compressed_image.hpp"
+#include "thermal_network/colormap.hpp"
+#include "thermal_network/image_encoder.hpp"
+
+namespace thermal_network
+{
+
+class CompressedPublisher
+{
+/// \brief Publishes frames of palette indices as compressed images
+
+public:
+  /// \brief Creates the publisher and starts the encoder thread
+  /// \param node Node the publisher is created on, the publisher is a plain one that does not
+  ///     follow the lifecycle of the node
+  /// \param topic Topic of the compressed images
+  /// \param frame_id Frame id of the images
+  /// \param codec Format of the images
+  /// \param quality See encode_image()
+  CompressedPublisher(
+    rclcpp_lifecycle::LifecycleNode & node, const std::string & topic, const std::string & frame_id,
+    ImageCodec codec, int quality);
+
+  /// \brief Stops the encoder thread, a frame that is waiting is not published
+  ~CompressedPublisher();
+
+  CompressedPublisher(const CompressedPublisher &) = delete;
+  CompressedPublisher & operator=(const CompressedPublisher &) = delete;
+
+  /// \brief Whether anyone subscribes to the topic
+  bool has_subscribers() const;
+
+  /// \brief Hands a frame to the encoder thread, replacing the one still waiting if any
+  /// \param index Palette index of each pixel, row major
+  /// \param width Width in pixels
+  /// \param height Height in pixels
+  /// \param palette Palette the indices refer to
+  /// \param stamp Time the frame is stamped with
+  void submit(
+    const uint8_t * index, std::size_t width, std::size_t height, Palette palette,
+    const rclcpp::Time & stamp);
+
+  /// \brief Number of frames replaced before the encoder got to them
+  uint64_t replaced() const {return replaced_;}
+
+private:
+  struct Job
+  {
+    std::vector<uint8_t> index;
+    std::size_t width = 0;
+    std::size_t height = 0;
+    Palette palette = Palette::kIronblack;
+    rclcpp::Time stamp;
+  };
+
+  rclcpp::Logger logger_;
+  rclcpp::Clock clock_{RCL_STEADY_TIME};
+  std::string frame_id_;
+  ImageCodec codec_;
+  int quality_;
+  rclcpp::Publisher<sensor_msgs::msg::CompressedImage>::SharedPtr publisher_;
+
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  Job pending_;
+  bool has_pending_ = false;
+  bool running_ = true;
+  std::atomic<uint64_t> replaced_{0};
+  std::thread thread_;
+
+  void run();
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__COMPRESSED_PUBLISHER_HPP_
@@ -0,0 +1,86 @@
+/// \file GPU image messages
+/// \brief Type adapter publishing device frames as sensor_msgs::msg::Image (REP-2007)
+///
+/// Subscribers in the same process that subscribe with CudaImage receive the device buffers
+/// of the frame as published, nothing is copied. Every other subscriber gets a regular RGB8
+/// image, the middleware downloads it when converting.
+
+#ifndef THERMAL_NETWORK__CUDA_IMAGE_HPP_
+#define THERMAL_NETWORK__CUDA_IMAGE_HPP_
+
+#include <memory>
+#include <type_traits>
+
+#include "rclcpp/type_adapter.hpp"
+#include "sensor_msgs/image_encodings.hpp"
+#include "sensor_msgs/msg/image.hpp"
+#include "std_msgs/msg/header.hpp"
+#include "thermal_network/cuda_renderer.hpp"
+
+namespace thermal_network
+{
+
+/// \brief Rendered frame in device memory, with its raw values and temperatures
+struct CudaImage
+{
+  std_msgs::msg::Header header;
+  /// \brief Device buffers, shared with the pool of the renderer until the last holder drops
+  /// them, nullptr when a conversion failed
+  std::shared_ptr<const CudaFrame> frame;
+};
+
+}  // namespace thermal_network
+
+template<>
+struct rclcpp::TypeAdapter<thermal_network::CudaImage, sensor_msgs::msg::Image>
+{
+  using is_specialized = std::true_type;
+  using custom_type = thermal_network::CudaImage;
+  using ros_message_type = sensor_msgs::msg::Image;
+
+  /// \brief Downloads the RGB8 image, an image without data when the download fails
+  static void convert_to_ros_message(const custom_type & source, ros_message_type & destination)
+  {
+    destination.header = source.header;
+    destination.encoding = sensor_msgs::image_encodings::RGB8;
+    destination.is_bigendian = false;
+    destination.width = 0;
+    destination.height = 0;
+    destination.step = 0;
+    destination.data.clear();
+    if (!source.frame) {
+      return;
+    }
+    destination.data.resize(source.frame->size() * 3);
+    if (!thermal_network::download_rgb(*source.frame, destination.data.data())) {
+      destination.data.clear();
+      return;
+    }
+    destination.width = source.frame->width;
+    destination.height = source.frame->height;
+    destination.step = source.frame->width * 3;
+  }
+
+  /// \brief Uploads an RGB8 image, the frame stays nullptr for other encodings or on failure
+  static void convert_to_custom(const ros_message_type & source, custom_type & destination)
+  {
+    destination.header = source.header;
+    destination.frame.reset();
+    const std::size_t bytes = static_cast<std::size_t>(source.width) * source.height * 3;
+    if (source.encoding != sensor_msgs::image_encodings::RGB8 ||
+      source.step != source.width * 3 || source.data.size() < bytes)
+    {
+      return;
+    }
+    auto frame = std::make_shared<thermal_network::CudaFrame>();
+    if (frame->allocate(source.width, source.height) &&
+      thermal_network::upload_rgb(source.data.data(), *frame))
+    {
+      destination.frame = frame;
+    }
+  }
+};
+
+RCLCPP_USING_CUSTOM_TYPE_AS_ROS_MESSAGE_TYPE(thermal_network::CudaImage, sensor_msgs::msg::Image);
+
+#endif  // THERMAL_NETWORK__CUDA_IMAGE_HPP_
@@ -0,0 +1,131 @@
+/// \file CUDA rendering
+/// \brief Maps decoded frames onto the palette and converts them to Celsius on the GPU
+///
+/// The decoded frame is copied once into pinned memory and uploaded, everything computed from
+/// it afterwards stays in device memory, so a detector running on the GPU takes the frame
+/// without copying it back up. Frames come from a small pool and return to it once the last
+/// consumer drops them, the steady state allocates no device memory. Only built with the
+/// THERMAL_NETWORK_CUDA CMake option.
+
+#ifndef THERMAL_NETWORK__CUDA_RENDERER_HPP_
+#define THERMAL_NETWORK__CUDA_RENDERER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "thermal_network/colormap.hpp"
+#include "thermal_network/frame_decoder.hpp"
+
+namespace thermal_network
+{
+
+/// \brief Number of frames a renderer keeps, frames still held by consumers are not reused
+constexpr std::size_t kCudaFramePool = 4;
+
+/// \brief One frame in device memory
+struct CudaFrame
+{
+  std::size_t width = 0;
+  std::size_t height = 0;
+  /// \brief Raw centikelvin values, row major
+  uint16_t * raw = nullptr;
+  /// \brief Colormapped image, RGB8
+  uint8_t * rgb = nullptr;
+  /// \brief Temperatures in degrees Celsius, converted the same way as to_celsius()
+  float * celsius = nullptr;
+
+  CudaFrame() = default;
+
+  /// \brief Frees the device buffers
+  ~CudaFrame();
+
+  CudaFrame(const CudaFrame &) = delete;
+  CudaFrame & operator=(const CudaFrame &) = delete;
+
+  /// \brief Allocates the device buffers of a frame
+  /// \return false when CUDA fails
+  bool allocate(std::size_t frame_width, std::size_t frame_height);
+
+  /// \brief Number of pixels
+  std::size_t size() const {return width * height;}
+};
+
+/// \brief Copies the RGB8 image of a frame into host memory
+/// \param frame Frame as rendered
+/// \param rgb Output of frame.size() * 3 bytes
+/// \return false when CUDA fails
+bool download_rgb(const CudaFrame & frame, uint8_t * rgb);
+
+/// \brief Copies an RGB8 image into a frame, its raw values and temperatures are zeroed
+/// \param rgb Image of frame.size() * 3 bytes
+/// \param frame Allocated frame
+/// \return false when CUDA fails
+bool upload_rgb(const uint8_t * rgb, CudaFrame & frame);
+
+/// \brief Mapping of the raw values onto the palette, the settings of a ColormapLut
+struct CudaColormap
+{
+  Palette palette = Palette::kIronblack;
+  /// \brief Linear range, see normalize()
+  uint16_t min = 0;
+  uint16_t max = 0;
+  float scale = 0.0f;
+  /// \brief Palette index of raw value first + i, replaces the range when set and not empty
+  uint16_t first = 0;
+  const std::vector<uint8_t> * mapping = nullptr;
+};
+
+class CudaRenderer
+{
+/// \brief Renders decoded frames into pooled device frames
+
+public:
+  CudaRenderer() = default;
+
+  /// \brief Frees the stream and the buffers, frames still held by consumers stay valid
+  ~CudaRenderer();
+
+  CudaRenderer(const CudaRenderer &) = delete;
+  CudaRenderer & operator=(const CudaRenderer &) = delete;
+
+  /// \brief Creates the stream and the pinned staging buffer
+  /// \param pixels Number of pixels of the largest frame to render
+  /// \return false when there is no CUDA device or CUDA fails, see error()
+  bool open(std::size_t pixels);
+
+  /// \brief Uploads a decoded frame, maps it onto the palette and converts it to Celsius
+  /// \param raw Decoded frame, at most as large as given to open()
+  /// \param colormap Mapping onto the palette
+  /// \return Frame, complete when this returns, or nullptr when CUDA failed or consumers hold
+  ///     all frames of the pool, see error()
+  std::shared_ptr<const CudaFrame> render(const RawFrame & raw, const CudaColormap & colormap);
+
+  /// \brief Description of the last failure
+  const std::string & error() const {return error_;}
+
+private:
+  void * stream_ = nullptr;  // cudaStream_t
+  uint16_t * staging_ = nullptr;  // Pinned host memory
+  std::size_t pixels_ = 0;
+  uint8_t * mapping_ = nullptr;  // Device copy of the histogram mapping
+  std::vector<uint8_t> uploaded_mapping_;
+  bool has_palette_ = false;
+  Palette palette_ = Palette::kIronblack;
+  std::vector<std::shared_ptr<CudaFrame>> frames_;
+  std::string error_;
+
+  /// \brief Takes a frame of the pool that no consumer holds, allocating one if there is room
+  std::shared_ptr<CudaFrame> free_frame(std::size_t width, std::size_t height);
+
+  /// \brief Records a CUDA failure in error_
+  /// \param result cudaError_t of a call
+  /// \return true when the call succeeded
+  bool check(int result, const std::string & what);
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__CUDA_RENDERER_HPP_
@@ -0,0 +1,76 @@
+/// \file Vectorized decode kernels
+/// \brief Scalar, SSE4.1, AVX2 and NEON implementations of the decode passes
+///
+/// Every kernel set produces bit-exact the same output as the scalar one. The best set the CPU
+/// supports is picked on first use, use_decode_kernels() overrides the choice. Each set has its
+/// frame decoder instantiated for every entry of kSensorGeometries, so the packet walk of each
+/// layout is a fixed trip count loop.
+
+#ifndef THERMAL_NETWORK__DECODE_KERNELS_HPP_
+#define THERMAL_NETWORK__DECODE_KERNELS_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "thermal_network/frame_decoder.hpp"
+
+namespace thermal_network
+{
+
+/// \brief Frame decoder of one layout
+using DecodeFrameKernel = void (*)(const Frame & frame, RawFrame & raw);
+/// \brief Frame decoders of all layouts, indexed like kSensorGeometries
+using DecodeFrameTable = std::array<DecodeFrameKernel, kSensorGeometryCount>;
+
+/// \brief Instantiates a decoder for every layout
+/// \tparam Decoder Class template with a static decode() for the layout kSensorGeometries[G]
+template<template<std::size_t> class Decoder, std::size_t ... G>
+constexpr DecodeFrameTable make_decode_frame_table(std::index_sequence<G...>)
+{
+  return {{&Decoder<G>::decode ...}};
+}
+
+template<template<std::size_t> class Decoder>
+constexpr DecodeFrameTable make_decode_frame_table()
+{
+  return make_decode_frame_table<Decoder>(std::make_index_sequence<kSensorGeometryCount>());
+}
+
+/// \brief One implementation of each decode pass, see frame_decoder.hpp
+struct DecodeKernels
+{
+  const char * name;
+  DecodeFrameTable decode_frame;
+  void (* normalize)(
+    const uint16_t * raw, std::size_t count, uint16_t min, uint16_t max, float scale,
+    uint8_t * index);
+  void (* to_celsius)(const uint16_t * raw, std::size_t count, float * celsius);
+  void (* calibrate)(
+    uint16_t * raw, std::size_t count, const float * gain, const float * offset);
+};
+
+/// \brief Kernel sets built for this architecture, nullptr when not available
+const DecodeKernels * scalar_kernels();
+const DecodeKernels * sse41_kernels();
+const DecodeKernels * avx2_kernels();
+const DecodeKernels * neon_kernels();
+
+/// \brief Looks up a kernel set the CPU can run
+/// \param name scalar, sse4.1, avx2, neon or auto for the fastest one
+/// \return nullptr when the set is unknown or not supported
+const DecodeKernels * find_decode_kernels(const std::string & name);
+
+/// \brief Kernel set used by decode_frame(), normalize(), to_celsius() and calibrate()
+const DecodeKernels & active_decode_kernels();
+
+/// \brief Selects the kernel set used from now on
+/// \param name See find_decode_kernels()
+/// \return false when the set cannot be used, the active set is kept then
+bool use_decode_kernels(const std::string & name);
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__DECODE_KERNELS_HPP_
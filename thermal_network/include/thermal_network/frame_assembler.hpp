@@ -0,0 +1,88 @@
+/// \file Lepton frame reassembly
+/// \brief Places received segments into frames using the VoSPI segment number
+
+#ifndef THERMAL_NETWORK__FRAME_ASSEMBLER_HPP_
+#define THERMAL_NETWORK__FRAME_ASSEMBLER_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "thermal_network/lepton.hpp"
+
+namespace thermal_network
+{
+
+/// \brief All segments of one frame, back to back in segment order
+struct Frame
+{
+  std::array<uint8_t, kFrameBytes> data;
+  /// \brief Layout of the data, index into kSensorGeometries
+  std::size_t geometry = kDefaultSensorGeometry;
+  /// \brief Receive time of the first segment in nanoseconds since the epoch, 0 when unknown
+  int64_t stamp_ns = 0;
+};
+
+/// \brief Reads the segment number from the ID word of packet 20 of a segment
+/// \param segment Start of a segment of geometry.segment_bytes() bytes
+/// \param geometry Layout of the sensor, an unsegmented frame always reads as segment 1
+/// \return Segment number from 1 to geometry.segments, or 0 when the segment is invalid
+int segment_number(const uint8_t * segment, const SensorGeometry & geometry);
+
+class FrameAssembler
+{
+/// \brief Collects segments of a frame and reports when it is complete
+///
+/// The Lepton sends segment 1 first, so it always opens a new frame. The other segments may
+/// arrive in any order. A frame missing a segment is dropped when the next segment 1 arrives,
+/// when one of its segments is received twice or when it times out.
+
+public:
+  /// \brief Constructor
+  /// \param timeout_ns Time after the first segment within which a frame has to be complete
+  /// \param geometry Layout of the sensor, index into kSensorGeometries
+  explicit FrameAssembler(int64_t timeout_ns, std::size_t geometry = kDefaultSensorGeometry);
+
+  /// \brief Copies a segment into its slot of the frame being assembled
+  /// \param data Start of the segment
+  /// \param size Number of bytes received
+  /// \param stamp_ns Receive time of the segment
+  /// \param now_ns Monotonic time used for the timeout
+  /// \param frame Frame being assembled, the same frame has to be passed until it is complete
+  /// \return true when the segment completed the frame
+  bool add(
+    const uint8_t * data, std::size_t size, int64_t stamp_ns, int64_t now_ns,
+    Frame & frame);
+
+  /// \brief Drops the frame being assembled
+  void reset();
+
+  /// \brief Number of complete frames
+  uint64_t complete_frames() const {return complete_frames_;}
+  /// \brief Number of frames dropped because a segment was missing
+  uint64_t incomplete_frames() const {return incomplete_frames_;}
+  /// \brief Number of segments with a bad size, packet number or segment number
+  uint64_t invalid_segments() const {return invalid_segments_;}
+  /// \brief Number of segments received while no frame was open
+  uint64_t orphan_segments() const {return orphan_segments_;}
+
+private:
+  int64_t timeout_ns_;
+  std::size_t geometry_;
+  unsigned int all_segments_;
+  unsigned int present_ = 0;
+  int64_t started_ns_ = 0;
+
+  // Read by the diagnostics while the receive thread counts
+  std::atomic<uint64_t> complete_frames_{0};
+  std::atomic<uint64_t> incomplete_frames_{0};
+  std::atomic<uint64_t> invalid_segments_{0};
+  std::atomic<uint64_t> orphan_segments_{0};
+
+  void drop_incomplete();
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__FRAME_ASSEMBLER_HPP_
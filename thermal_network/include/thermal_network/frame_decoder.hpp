@@ -0,0 +1,139 @@
+/// \file Lepton frame decoding
+/// \brief Turns the big-endian segments of a frame into a dense raw frame and derived outputs
+///
+/// Decoding is split in separate passes over contiguous buffers. decode_frame() byte-swaps a
+/// frame once into a row-major uint16_t buffer and finds its range while doing so, the other
+/// passes then run over that buffer without any packet layout left to skip.
+
+#ifndef THERMAL_NETWORK__FRAME_DECODER_HPP_
+#define THERMAL_NETWORK__FRAME_DECODER_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "thermal_network/frame_assembler.hpp"
+#include "thermal_network/lepton.hpp"
+
+namespace thermal_network
+{
+
+/// \brief Number of pixels in the largest frame
+constexpr std::size_t kFramePixels = kFrameWidth * kFrameHeight;
+
+/// \brief Frame of raw values in centikelvin, row major
+struct RawFrame
+{
+  /// \brief Pixels, only the first width * height are used
+  std::array<uint16_t, kFramePixels> pixels;
+  std::size_t width = kFrameWidth;
+  std::size_t height = kFrameHeight;
+  /// \brief Smallest non-zero pixel value
+  uint16_t min = 0;
+  /// \brief Largest pixel value
+  uint16_t max = 0;
+  /// \brief Number of pixels that read as zero, a healthy frame has none
+  std::size_t zero_pixels = 0;
+
+  /// \brief Number of pixels used
+  std::size_t size() const {return width * height;}
+};
+
+/// \brief Rectangle of a frame in pixels
+struct Region
+{
+  /// \brief Name the region or its statistics are published with
+  std::string name;
+  std::size_t x = 0;
+  std::size_t y = 0;
+  std::size_t width = kFrameWidth;
+  std::size_t height = kFrameHeight;
+};
+
+/// \brief Summary of the raw values of a region
+struct RegionStats
+{
+  uint16_t min = 0;
+  uint16_t max = 0;
+  /// \brief Mean raw value, not rounded
+  double mean = 0.0;
+  /// \brief Column of the hottest pixel, the first one in row-major order on ties
+  std::size_t hottest_x = 0;
+  /// \brief Row of the hottest pixel
+  std::size_t hottest_y = 0;
+};
+
+/// \brief How pool() combines the pixels of a block
+enum class PoolMode
+{
+  kMean,  /// Rounded mean of the block
+  kMax,   /// Hottest pixel of the block
+};
+
+/// \brief Parses mean or max
+/// \return false when the name is unknown
+bool parse_pool_mode(const std::string & name, PoolMode & mode);
+
+/// \brief Byte-swaps the pixels of all segments into raw and computes its range in the same sweep
+/// \param frame Complete frame as received, decoded with the layout it was assembled with
+/// \param raw Decoded frame, its size is set from the layout
+void decode_frame(const Frame & frame, RawFrame & raw);
+
+/// \brief Maps raw values to an 8 bit colormap index
+///
+/// Values up to min map to 0, values from max map to 255 and values in between are scaled
+/// linearly by scale.
+/// \param raw Raw values
+/// \param count Number of values
+/// \param min Lower end of the range
+/// \param max Upper end of the range
+/// \param scale 255 / (max - min)
+/// \param index Output indices
+void normalize(
+  const uint16_t * raw, std::size_t count, uint16_t min, uint16_t max, float scale,
+  uint8_t * index);
+
+/// \brief Converts raw centikelvin values to degrees Celsius
+/// \param raw Raw values
+/// \param count Number of values
+/// \param celsius Output temperatures
+void to_celsius(const uint16_t * raw, std::size_t count, float * celsius);
+
+/// \brief Applies a per-pixel linear correction in place
+///
+/// Each value becomes raw * gain + offset, clamped to the uint16_t range and rounded to the
+/// nearest integer.
+/// \param raw Raw values
+/// \param count Number of values
+/// \param gain Gain of each value
+/// \param offset Offset of each value in centikelvin
+void calibrate(uint16_t * raw, std::size_t count, const float * gain, const float * offset);
+
+/// \brief Computes the statistics of a region in a single sweep over the decoded frame
+/// \param raw Decoded frame
+/// \param region Region, the part outside of the frame is ignored
+/// \return Statistics, all zero when no pixel of the region lies inside of the frame
+RegionStats region_stats(const RawFrame & raw, const Region & region);
+
+/// \brief Recomputes min, max and zero_pixels of a frame whose pixels were changed
+/// \param raw Frame, its width and height tell which pixels are used
+void update_range(RawFrame & raw);
+
+/// \brief Copies a region of a decoded frame into a frame of its own
+/// \param raw Decoded frame
+/// \param region Region, the part outside of the frame is cut off
+/// \param out Cropped frame with its range, empty when no pixel of the region lies inside of the
+///     frame
+void crop(const RawFrame & raw, const Region & region, RawFrame & out);
+
+/// \brief Downscales a decoded frame by combining blocks of factor x factor pixels
+/// \param raw Decoded frame, rows and columns that do not fill a whole block are left out
+/// \param factor Width and height of a block, at least 1
+/// \param mode How the pixels of a block are combined
+/// \param out Downscaled frame with its range
+void pool(const RawFrame & raw, std::size_t factor, PoolMode mode, RawFrame & out);
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__FRAME_DECODER_HPP_
@@ -0,0 +1,49 @@
+/// \file Histogram equalized automatic gain control
+/// \brief Maps raw values to palette indices by their rank in the frame instead of linearly
+///
+/// A single hot pixel stretches a min/max range so far that the rest of the image ends up in a
+/// few colors. Equalizing spreads the palette over the values by how many pixels have them.
+/// The histogram covers all 65536 raw values and is kept from frame to frame, only the bins of
+/// the pixels that changed are updated, so it never has to be cleared. The cumulative
+/// distribution is only walked over the range of the current frame.
+
+#ifndef THERMAL_NETWORK__HISTOGRAM_AGC_HPP_
+#define THERMAL_NETWORK__HISTOGRAM_AGC_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "thermal_network/frame_decoder.hpp"
+
+namespace thermal_network
+{
+
+class HistogramAgc
+{
+/// \brief Builds a raw value to palette index table from the histogram of the frames
+
+public:
+  /// \brief Allocates the histogram
+  /// \param clip_percent Percentage of the pixels that saturates at each end of the palette
+  explicit HistogramAgc(double clip_percent = 0.0);
+
+  /// \brief Adds a frame to the histogram and computes the table for it
+  /// \param raw Decoded frame, its range bounds the table
+  /// \param first Raw value of the first entry of index
+  /// \param index Palette index of each raw value from first on, values below first map to 0
+  ///     and values past the end map to 255
+  void equalize(const RawFrame & raw, uint16_t & first, std::vector<uint8_t> & index);
+
+private:
+  /// \brief Share of the pixels that saturates at each end
+  double clip_share_;
+  std::vector<uint32_t> histogram_;
+  /// \brief Pixels the histogram currently holds
+  std::vector<uint16_t> previous_;
+  bool primed_ = false;
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__HISTOGRAM_AGC_HPP_
@@ -0,0 +1,59 @@
+/// \file Image compression
+/// \brief Encodes palette indexed frames as PNG, QOI or JPEG
+///
+/// The input is always the 8 bit palette index of each pixel plus the palette. PNG keeps it
+/// that way as an indexed image with the palette in its PLTE chunk, a third of the data of the
+/// RGB image before zlib even starts. QOI and JPEG expand the indices to RGB while encoding.
+/// JPEG is only available when the package was built against libjpeg.
+
+#ifndef THERMAL_NETWORK__IMAGE_ENCODER_HPP_
+#define THERMAL_NETWORK__IMAGE_ENCODER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "thermal_network/colormap.hpp"
+
+namespace thermal_network
+{
+
+/// \brief Formats of the compressed image
+enum class ImageCodec
+{
+  kPng,   /// Lossless, indexed color
+  kQoi,   /// Lossless, fast, RGB
+  kJpeg,  /// Lossy, RGB
+};
+
+/// \brief Parses png, qoi or jpeg
+/// \return false when the name is unknown or the codec was not built in
+bool parse_image_codec(const std::string & name, ImageCodec & codec);
+
+/// \brief Name of a codec, as parsed by parse_image_codec()
+const char * image_codec_name(ImageCodec codec);
+
+/// \brief sensor_msgs::msg::CompressedImage::format of a codec, in the form of image_transport,
+/// "rgb8; png compressed rgb8"
+///
+/// The compressed transport of image_transport decodes png and jpeg, qoi follows the same scheme
+/// but needs a subscriber that decodes it.
+const char * compressed_image_format(ImageCodec codec);
+
+/// \brief Encodes a palette indexed image
+/// \param codec Format to encode to
+/// \param index Palette index of each pixel, row major
+/// \param width Width in pixels
+/// \param height Height in pixels
+/// \param colors Palette the indices refer to
+/// \param quality JPEG quality from 1 to 100, PNG zlib level from 1 to 9, unused for QOI
+/// \param out Encoded image
+/// \return false when encoding failed
+bool encode_image(
+  ImageCodec codec, const uint8_t * index, std::size_t width, std::size_t height,
+  const PaletteColors & colors, int quality, std::vector<uint8_t> & out);
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__IMAGE_ENCODER_HPP_
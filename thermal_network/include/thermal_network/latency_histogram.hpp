@@ -0,0 +1,109 @@
+/// \file Hot-path latency measurement
+/// \brief Lock-free log-bucketed histogram of durations and the steady clock they are taken with
+///
+/// Each power of two is split into four buckets, so a quantile is known to within 25 percent
+/// over the whole range from nanoseconds to seconds. Recording is one relaxed atomic increment,
+/// the thread publishing diagnostics takes the counts and clears them in one go.
+
+#ifndef THERMAL_NETWORK__LATENCY_HISTOGRAM_HPP_
+#define THERMAL_NETWORK__LATENCY_HISTOGRAM_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace thermal_network
+{
+
+/// \brief Quantiles of the durations recorded since the previous snapshot
+struct LatencySummary
+{
+  uint64_t count = 0;
+  int64_t p50_ns = 0;
+  int64_t p99_ns = 0;
+  int64_t max_ns = 0;
+};
+
+class LatencyHistogram
+{
+/// \brief Counts durations by magnitude, written by one thread and read by another
+
+public:
+  /// \brief Adds a duration
+  void record(int64_t ns)
+  {
+    buckets_[bucket(ns < 0 ? 0 : static_cast<uint64_t>(ns))].fetch_add(
+      1, std::memory_order_relaxed);
+  }
+
+  /// \brief Takes the durations recorded so far and starts over
+  LatencySummary take()
+  {
+    std::array<uint64_t, kBuckets> counts;
+    LatencySummary summary;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+      counts[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+      summary.count += counts[i];
+    }
+    if (summary.count == 0) {
+      return summary;
+    }
+    const uint64_t p50 = (summary.count + 1) / 2;
+    const uint64_t p99 = summary.count - summary.count / 100;
+    uint64_t cumulative = 0;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+      if (counts[i] == 0) {
+        continue;
+      }
+      if (cumulative < p50 && cumulative + counts[i] >= p50) {
+        summary.p50_ns = upper_bound(i);
+      }
+      if (cumulative < p99 && cumulative + counts[i] >= p99) {
+        summary.p99_ns = upper_bound(i);
+      }
+      cumulative += counts[i];
+      summary.max_ns = upper_bound(i);
+    }
+    return summary;
+  }
+
+private:
+  static constexpr std::size_t kSubBuckets = 4;
+  static constexpr std::size_t kBuckets = 64 * kSubBuckets;
+
+  std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+
+  static std::size_t bucket(uint64_t ns)
+  {
+    if (ns < kSubBuckets) {
+      return ns;
+    }
+    const int exponent = 63 - __builtin_clzll(ns);
+    return (exponent - 1) * kSubBuckets + ((ns >> (exponent - 2)) & (kSubBuckets - 1));
+  }
+
+  /// \brief Largest duration that falls in a bucket
+  static int64_t upper_bound(std::size_t index)
+  {
+    if (index < kSubBuckets) {
+      return index;
+    }
+    const std::size_t exponent = index / kSubBuckets + 1;
+    const uint64_t sub = index % kSubBuckets;
+    const uint64_t top = ((kSubBuckets + sub + 1) << (exponent - 2)) - 1;
+    return top > INT64_MAX ? INT64_MAX : static_cast<int64_t>(top);
+  }
+};
+
+/// \brief Steady clock in nanoseconds
+inline int64_t steady_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__LATENCY_HISTOGRAM_HPP_
@@ -0,0 +1,95 @@
+/// \file Lepton VoSPI stream layout
+/// \brief Sizes of the packets and the frame layouts of the Lepton models the sender supports
+///
+/// Every model sends Raw14 packets of 80 pixels. A Lepton 2.x sends a frame of 80x60 as one
+/// datagram, a Lepton 3.x splits its 160x120 frame into four segments of one datagram each.
+/// With telemetry enabled the telemetry packets precede (header) or follow (footer) the video
+/// packets of the frame, so segments get longer but the video packets stay contiguous once the
+/// segments are put back to back.
+
+#ifndef THERMAL_NETWORK__LEPTON_HPP_
+#define THERMAL_NETWORK__LEPTON_HPP_
+
+#include <cstddef>
+#include <string>
+
+namespace thermal_network
+{
+
+/// \brief Number of 16 bit words in a VoSPI packet, 2 header words and 80 pixels
+constexpr std::size_t kPacketWords = 82;
+/// \brief Number of header words at the start of a VoSPI packet (ID and CRC)
+constexpr std::size_t kPacketHeaderWords = 2;
+/// \brief Number of pixels in a VoSPI packet
+constexpr std::size_t kPacketPixels = kPacketWords - kPacketHeaderWords;
+/// \brief Size of a VoSPI packet in bytes
+constexpr std::size_t kPacketBytes = kPacketWords * 2;
+
+/// \brief Frame layout of a sensor model
+struct SensorGeometry
+{
+  /// \brief Model family, lepton2 or lepton3
+  const char * family;
+  std::size_t width;
+  std::size_t height;
+  /// \brief Number of datagrams a frame is sent in
+  std::size_t segments;
+  /// \brief Number of packets in a segment, telemetry included
+  std::size_t packets_per_segment;
+  /// \brief Number of telemetry packets in a frame
+  std::size_t telemetry_packets;
+  /// \brief Telemetry follows the video packets instead of preceding them
+  bool telemetry_footer;
+
+  constexpr std::size_t pixels() const {return width * height;}
+  constexpr std::size_t video_packets() const {return pixels() / kPacketPixels;}
+  constexpr std::size_t segment_bytes() const {return packets_per_segment * kPacketBytes;}
+  constexpr std::size_t frame_bytes() const {return segments * segment_bytes();}
+  /// \brief Offset of the first video packet in the segments put back to back
+  constexpr std::size_t video_offset() const
+  {
+    return telemetry_footer ? 0 : telemetry_packets * kPacketBytes;
+  }
+  /// \brief Offset of the first telemetry packet in the segments put back to back
+  constexpr std::size_t telemetry_offset() const
+  {
+    return telemetry_footer ? video_packets() * kPacketBytes : 0;
+  }
+};
+
+/// \brief All layouts, the decoders are specialized for each of them at compile time
+constexpr SensorGeometry kSensorGeometries[] = {
+  {"lepton3", 160, 120, 4, 60, 0, false},
+  {"lepton3", 160, 120, 4, 61, 4, false},
+  {"lepton3", 160, 120, 4, 61, 4, true},
+  {"lepton2", 80, 60, 1, 60, 0, false},
+  {"lepton2", 80, 60, 1, 63, 3, false},
+  {"lepton2", 80, 60, 1, 63, 3, true},
+};
+constexpr std::size_t kSensorGeometryCount =
+  sizeof(kSensorGeometries) / sizeof(kSensorGeometries[0]);
+/// \brief Layout of the Lepton 3.1R without telemetry, the sender's default
+constexpr std::size_t kDefaultSensorGeometry = 0;
+
+/// \brief Largest width of all layouts
+constexpr std::size_t kFrameWidth = 160;
+/// \brief Largest height of all layouts
+constexpr std::size_t kFrameHeight = 120;
+/// \brief Largest number of datagrams of a frame
+constexpr std::size_t kSegmentsPerFrame = 4;
+/// \brief Largest datagram of all layouts
+constexpr std::size_t kSegmentBytes = 63 * kPacketBytes;
+/// \brief Largest frame of all layouts, segments back to back
+constexpr std::size_t kFrameBytes = 4 * 61 * kPacketBytes;
+
+/// \brief Looks up the layout of a sensor model
+/// \param sensor lepton2, lepton2.5, lepton3, lepton3.1r or lepton3.5
+/// \param telemetry none, header or footer, as configured on the sensor
+/// \param geometry Index into kSensorGeometries
+/// \return false when the model or the telemetry location is unknown
+bool find_sensor_geometry(
+  const std::string & sensor, const std::string & telemetry, std::size_t & geometry);
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__LEPTON_HPP_
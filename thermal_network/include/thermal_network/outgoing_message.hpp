@@ -0,0 +1,85 @@
+/// \file Outgoing message wrapper for zero-copy publishing
+/// \brief Hands out a message to fill in place, loaned from the middleware when possible
+///
+/// When the RMW supports loaning, the message lives in middleware owned memory and is
+/// published without a copy. Otherwise, and whenever a component in the same process
+/// subscribes, the message is heap allocated and published as a unique_ptr so intra-process
+/// subscribers take ownership without a copy. A publisher without intra-process comms can
+/// instead be given a message that is reused for every publish, sized by the first frame and
+/// serialized by reference, so publishing allocates nothing.
+
+#ifndef THERMAL_NETWORK__OUTGOING_MESSAGE_HPP_
+#define THERMAL_NETWORK__OUTGOING_MESSAGE_HPP_
+
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "rclcpp/rclcpp.hpp"
+
+namespace thermal_network
+{
+
+template<typename MessageT>
+class OutgoingMessage
+{
+/// \brief Message that is written in place and then published exactly once
+
+public:
+  /// \brief Acquires a message from the publisher
+  /// \param publisher Publisher the message is going to be sent on
+  /// \param reusable Message used when no loan is available, it keeps its contents between
+  ///     publishes, only for publishers with intra-process comms disabled
+  explicit OutgoingMessage(
+    typename rclcpp::Publisher<MessageT>::SharedPtr publisher, MessageT * reusable = nullptr)
+  : publisher_(std::move(publisher))
+  {
+    if (publisher_->can_loan_messages() &&
+      publisher_->get_intra_process_subscription_count() == 0)
+    {
+      loaned_.emplace(publisher_->borrow_loaned_message());
+      message_ = &loaned_->get();
+    } else if (reusable != nullptr) {
+      reused_ = reusable;
+      message_ = reusable;
+    } else {
+      owned_ = std::make_unique<MessageT>();
+      message_ = owned_.get();
+    }
+  }
+
+  OutgoingMessage(const OutgoingMessage &) = delete;
+  OutgoingMessage & operator=(const OutgoingMessage &) = delete;
+
+  /// \brief Message to be filled before publishing
+  MessageT & get() {return *message_;}
+
+  /// \brief Whether the message is backed by middleware memory
+  bool is_loaned() const {return loaned_.has_value();}
+
+  /// \brief Publishes the message, giving up ownership of it
+  void publish()
+  {
+    if (loaned_) {
+      publisher_->publish(std::move(*loaned_));
+      loaned_.reset();
+    } else if (owned_) {
+      publisher_->publish(std::move(owned_));
+    } else if (reused_ != nullptr) {
+      publisher_->publish(*reused_);
+      reused_ = nullptr;
+    }
+    message_ = nullptr;
+  }
+
+private:
+  typename rclcpp::Publisher<MessageT>::SharedPtr publisher_;
+  std::optional<rclcpp::LoanedMessage<MessageT>> loaned_;
+  std::unique_ptr<MessageT> owned_;
+  MessageT * reused_ = nullptr;
+  MessageT * message_ = nullptr;
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__OUTGOING_MESSAGE_HPP_
@@ -0,0 +1,61 @@
+/// \file Output rate limiting
+/// \brief Decimation and maximum rate applied to an output before any work is done for it
+
+#ifndef THERMAL_NETWORK__OUTPUT_THROTTLE_HPP_
+#define THERMAL_NETWORK__OUTPUT_THROTTLE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+
+namespace thermal_network
+{
+
+class OutputThrottle
+{
+/// \brief Decides which frames an output publishes
+
+public:
+  /// \brief Constructor
+  /// \param decimation Publish one frame out of this many, 1 publishes every frame
+  /// \param max_rate_hz Upper bound of the publishing rate, 0 for no bound
+  explicit OutputThrottle(int64_t decimation = 1, double max_rate_hz = 0.0)
+  : decimation_(std::max<int64_t>(decimation, 1)),
+    period_ns_(max_rate_hz > 0.0 ? static_cast<int64_t>(1e9 / max_rate_hz) : 0)
+  {
+  }
+
+  /// \brief Offers a frame to the output
+  /// \param now_ns Monotonic time of the frame
+  /// \return true when the frame should be published
+  bool accept(int64_t now_ns)
+  {
+    if (count_++ % decimation_ != 0) {
+      return false;
+    }
+    if (period_ns_ == 0) {
+      return true;
+    }
+    if (started_ && now_ns < next_ns_) {
+      return false;
+    }
+    // Deadlines advance by whole periods so the average rate meets the bound even though
+    // frames arrive on their own clock, a long pause does not cause a burst afterwards
+    next_ns_ = started_ ? next_ns_ + period_ns_ : now_ns + period_ns_;
+    if (next_ns_ <= now_ns) {
+      next_ns_ = now_ns + period_ns_;
+    }
+    started_ = true;
+    return true;
+  }
+
+private:
+  int64_t decimation_;
+  int64_t period_ns_;
+  int64_t count_ = 0;
+  int64_t next_ns_ = 0;
+  bool started_ = false;
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__OUTPUT_THROTTLE_HPP_
@@ -0,0 +1,53 @@
+/// \file Radiometric calibration
+/// \brief Per-pixel gain and offset tables applied to the decoded frames
+///
+/// A table file holds one 32 bit float per pixel of the frame, row major in host byte order, as
+/// numpy's ndarray.tofile() writes a float32 array. Gains are unitless, offsets in centikelvin.
+/// The tables are read once, applying them is a single calibrate() pass over the frame.
+
+#ifndef THERMAL_NETWORK__PIXEL_CALIBRATION_HPP_
+#define THERMAL_NETWORK__PIXEL_CALIBRATION_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "thermal_network/frame_decoder.hpp"
+
+namespace thermal_network
+{
+
+class PixelCalibration
+{
+/// \brief Corrects each pixel of a frame by raw * gain + offset
+
+public:
+  /// \brief Reads the tables
+  /// \param gain_file Gain table, empty for a gain of 1
+  /// \param offset_file Offset table, empty for an offset of 0
+  /// \param pixels Number of pixels of the frames the tables are for
+  /// \return false when a file cannot be read, has the wrong size or holds a value that is not
+  ///     finite, see error()
+  bool load(const std::string & gain_file, const std::string & offset_file, std::size_t pixels);
+
+  /// \brief Whether tables are loaded
+  bool enabled() const {return !gain_.empty();}
+
+  /// \brief Calibrates a frame in place and recomputes its range
+  /// \param raw Decoded frame of the size the tables were loaded for, without zero pixels
+  void apply(RawFrame & raw) const;
+
+  /// \brief Description of the last failure
+  const std::string & error() const {return error_;}
+
+private:
+  std::vector<float> gain_;
+  std::vector<float> offset_;
+  std::string error_;
+
+  bool read_table(const std::string & file, std::size_t pixels, std::vector<float> & table);
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__PIXEL_CALIBRATION_HPP_
@@ -0,0 +1,143 @@
+/// \file Raw segment recordings
+/// \brief Append-only capture of received segments and memory-mapped replay of it
+///
+/// A recording starts with a 16 byte file header, the magic "THRMSEG1", the format version and
+/// the size of a record header. Every datagram follows as a 16 byte record header and its bytes,
+/// padded to a multiple of 8 so the headers stay aligned inside the mapping. All integers are in
+/// host byte order. Recording into an existing file appends to it, so a capture survives a
+/// restart of the node, after cutting off a record the previous run left incomplete.
+
+#ifndef THERMAL_NETWORK__SEGMENT_RECORDING_HPP_
+#define THERMAL_NETWORK__SEGMENT_RECORDING_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace thermal_network
+{
+
+/// \brief Header in front of each recorded datagram
+struct SegmentRecordHeader
+{
+  /// \brief Receive time in nanoseconds since the epoch
+  int64_t stamp_ns;
+  /// \brief Number of bytes received
+  uint32_t size;
+  /// \brief Camera the datagram was received for, index into the ports of the node
+  uint16_t stream;
+  /// \brief kSegmentTruncated when the datagram did not fit the receive buffer
+  uint16_t flags;
+};
+
+constexpr uint16_t kSegmentTruncated = 1;
+
+/// \brief A datagram of a recording
+struct SegmentRecord
+{
+  int64_t stamp_ns = 0;
+  uint16_t stream = 0;
+  bool truncated = false;
+  /// \brief Bytes of the datagram, inside the mapping of the file
+  const uint8_t * data = nullptr;
+  std::size_t size = 0;
+};
+
+class SegmentRecorder
+{
+/// \brief Appends datagrams to a recording, written by a thread of its own so the receive thread
+/// only copies them into a buffer
+
+public:
+  SegmentRecorder() = default;
+  ~SegmentRecorder();
+
+  SegmentRecorder(const SegmentRecorder &) = delete;
+  SegmentRecorder & operator=(const SegmentRecorder &) = delete;
+
+  /// \brief Opens a recording for appending, creating it when it does not exist
+  ///
+  /// A record cut short at the end of an existing recording is truncated away first.
+  /// \return false when the file cannot be opened or is not a recording, see error()
+  bool open(const std::string & path);
+
+  /// \brief Writes out what is buffered and closes the file
+  void close();
+
+  /// \brief Whether a recording is open
+  bool is_open() const {return fd_ >= 0;}
+
+  /// \brief Adds a datagram, from one thread at a time
+  /// \return false when writing failed, nothing is recorded after that
+  bool record(
+    const uint8_t * data, std::size_t size, bool truncated, int64_t stamp_ns, uint16_t stream);
+
+  /// \brief Writes out what is buffered and waits until it is written, not while record() runs
+  /// \return false when writing failed
+  bool flush();
+
+  /// \brief Description of the last failure
+  const std::string & error() const {return error_;}
+
+private:
+  int fd_ = -1;
+  std::vector<uint8_t> buffer_;  // Filled by record()
+  std::string error_;
+
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::condition_variable written_;
+  std::vector<uint8_t> full_;  // Being written, swapped with buffer_ when that is full
+  bool has_full_ = false;
+  bool running_ = false;
+  std::atomic<bool> failed_{false};
+  std::thread thread_;
+
+  void run();
+  bool write_out(const std::vector<uint8_t> & bytes);
+  void set_error(const std::string & what);
+};
+
+class SegmentReplay
+{
+/// \brief Reads the datagrams of a recording through a read-only mapping of the file
+
+public:
+  SegmentReplay() = default;
+  ~SegmentReplay();
+
+  SegmentReplay(const SegmentReplay &) = delete;
+  SegmentReplay & operator=(const SegmentReplay &) = delete;
+
+  /// \brief Maps a recording
+  /// \return false when the file cannot be mapped or is not a recording, see error()
+  bool open(const std::string & path);
+
+  /// \brief Unmaps the recording
+  void close();
+
+  /// \brief Gets the next datagram
+  /// \return false at the end of the recording, a record cut short by a crash ends it too
+  bool next(SegmentRecord & record);
+
+  /// \brief Starts over at the first datagram
+  void rewind();
+
+  /// \brief Description of the last failure
+  const std::string & error() const {return error_;}
+
+private:
+  const uint8_t * data_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t offset_ = 0;
+  std::string error_;
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__SEGMENT_RECORDING_HPP_
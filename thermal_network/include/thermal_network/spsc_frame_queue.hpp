@@ -0,0 +1,173 @@
+/// \file Lock-free frame queue between the receive and the worker thread
+/// \brief Single-producer/single-consumer queue of preallocated frame buffers
+///
+/// Buffers are never copied, only their indices move through two rings: the ready ring from
+/// the producer to the consumer and the free ring back. The producer always owns one buffer
+/// to fill and the consumer owns the one it is processing, so capacity + 2 buffers are
+/// allocated up front. When the ready ring is full the producer either drops the frame it just
+/// filled or steals the oldest queued one, which is why the tail of the ready ring is advanced
+/// with a compare-and-swap by both sides. Waking the consumer up is left to the caller, see
+/// WorkerPool.
+
+#ifndef THERMAL_NETWORK__SPSC_FRAME_QUEUE_HPP_
+#define THERMAL_NETWORK__SPSC_FRAME_QUEUE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace thermal_network
+{
+
+/// \brief What to do with a new frame when the queue is full
+enum class DropPolicy
+{
+  kDropOldest,  /// Discard the oldest queued frame to make room
+  kDropNewest,  /// Discard the frame that was just filled
+};
+
+/// \brief Parses "drop_oldest" or "drop_newest"
+/// \return false when the name is unknown
+inline bool parse_drop_policy(const std::string & name, DropPolicy & policy)
+{
+  if (name == "drop_oldest") {
+    policy = DropPolicy::kDropOldest;
+  } else if (name == "drop_newest") {
+    policy = DropPolicy::kDropNewest;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+template<typename T>
+class SpscFrameQueue
+{
+/// \brief Hands filled buffers from one producer thread to one consumer thread
+
+public:
+  /// \brief Allocates all buffers
+  /// \param capacity Number of frames that can wait for the consumer
+  /// \param policy Behaviour when capacity frames are already waiting
+  SpscFrameQueue(std::size_t capacity, DropPolicy policy)
+  : capacity_(std::max<std::size_t>(capacity, 1)),
+    policy_(policy),
+    pool_(capacity_ + 2),
+    ready_(new std::atomic<uint32_t>[capacity_]),
+    free_(new std::atomic<uint32_t>[capacity_ + 2])
+  {
+    producer_index_ = 0;
+    for (uint32_t i = 1; i < pool_.size(); ++i) {
+      free_[i - 1].store(i, std::memory_order_relaxed);
+    }
+    free_head_.store(pool_.size() - 1, std::memory_order_release);
+  }
+
+  SpscFrameQueue(const SpscFrameQueue &) = delete;
+  SpscFrameQueue & operator=(const SpscFrameQueue &) = delete;
+
+  /// \brief Buffer the producer fills, it stays the same until push() succeeds
+  T & producer_buffer() {return pool_[producer_index_];}
+
+  /// \brief Queues the producer buffer and gets a fresh one, called by the producer only
+  /// \return false when a frame was dropped to honour the capacity
+  bool push()
+  {
+    const uint64_t head = ready_head_.load(std::memory_order_relaxed);
+    uint64_t tail = ready_tail_.load(std::memory_order_acquire);
+    uint32_t stolen = kNoBuffer;
+    if (head - tail >= capacity_) {
+      if (policy_ == DropPolicy::kDropNewest) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      while (head - tail >= capacity_) {
+        uint32_t oldest = ready_[tail % capacity_].load(std::memory_order_relaxed);
+        if (ready_tail_.compare_exchange_weak(
+            tail, tail + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+          stolen = oldest;
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+          break;
+        }
+      }
+    }
+
+    ready_[head % capacity_].store(producer_index_, std::memory_order_relaxed);
+    ready_head_.store(head + 1, std::memory_order_release);
+
+    if (stolen != kNoBuffer) {
+      producer_index_ = stolen;
+    } else {
+      // With capacity + 2 buffers a free one is always left once the ready ring has room
+      const uint64_t free_tail = free_tail_.load(std::memory_order_relaxed);
+      while (free_head_.load(std::memory_order_acquire) == free_tail) {
+      }
+      producer_index_ = free_[free_tail % pool_.size()].load(std::memory_order_relaxed);
+      free_tail_.store(free_tail + 1, std::memory_order_relaxed);
+    }
+    return stolen == kNoBuffer;
+  }
+
+  /// \brief Releases the previously popped buffer and takes the oldest queued frame,
+  /// called by the consumer only
+  /// \return Frame to process, valid until the next call, or nullptr when the queue is empty
+  T * pop()
+  {
+    if (consumer_index_ != kNoBuffer) {
+      const uint64_t free_head = free_head_.load(std::memory_order_relaxed);
+      free_[free_head % pool_.size()].store(consumer_index_, std::memory_order_relaxed);
+      free_head_.store(free_head + 1, std::memory_order_release);
+      consumer_index_ = kNoBuffer;
+    }
+
+    uint64_t tail = ready_tail_.load(std::memory_order_acquire);
+    while (tail != ready_head_.load(std::memory_order_acquire)) {
+      uint32_t index = ready_[tail % capacity_].load(std::memory_order_relaxed);
+      if (ready_tail_.compare_exchange_weak(
+          tail, tail + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        consumer_index_ = index;
+        return &pool_[index];
+      }
+    }
+    return nullptr;
+  }
+
+  /// \brief Whether the next push() has to drop a frame, called by the producer only
+  bool full() const
+  {
+    return ready_head_.load(std::memory_order_relaxed) -
+           ready_tail_.load(std::memory_order_acquire) >= capacity_;
+  }
+
+  /// \brief Number of frames dropped because the queue was full
+  uint64_t dropped() const {return dropped_.load(std::memory_order_relaxed);}
+
+private:
+  static constexpr uint32_t kNoBuffer = UINT32_MAX;
+
+  const std::size_t capacity_;
+  const DropPolicy policy_;
+  std::vector<T> pool_;
+
+  std::unique_ptr<std::atomic<uint32_t>[]> ready_;
+  alignas(64) std::atomic<uint64_t> ready_head_{0};
+  alignas(64) std::atomic<uint64_t> ready_tail_{0};
+
+  std::unique_ptr<std::atomic<uint32_t>[]> free_;
+  alignas(64) std::atomic<uint64_t> free_head_{0};
+  alignas(64) std::atomic<uint64_t> free_tail_{0};
+
+  uint32_t producer_index_ = kNoBuffer;
+  uint32_t consumer_index_ = kNoBuffer;
+  std::atomic<uint64_t> dropped_{0};
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__SPSC_FRAME_QUEUE_HPP_
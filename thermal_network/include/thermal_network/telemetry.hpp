@@ -0,0 +1,73 @@
+/// \file Lepton telemetry
+/// \brief Parsing of telemetry row A, which carries the frame counter and the FFC state
+///
+/// Telemetry words are big-endian like the pixels. Values spanning two words are sent least
+/// significant word first. During a flat-field correction the shutter closes in front of the
+/// sensor, so the frames sent while it is imminent or in progress do not show the scene.
+
+#ifndef THERMAL_NETWORK__TELEMETRY_HPP_
+#define THERMAL_NETWORK__TELEMETRY_HPP_
+
+#include <cstdint>
+#include <string>
+
+#include "thermal_network/frame_assembler.hpp"
+
+namespace thermal_network
+{
+
+/// \brief Flat-field correction state, bits 4 and 5 of the status word
+enum class FfcState : uint8_t
+{
+  kNever = 0,
+  kImminent = 1,
+  kInProgress = 2,
+  kComplete = 3,
+};
+
+/// \brief What is done with the frames sent during a flat-field correction
+enum class FfcPolicy
+{
+  /// \brief Frames are dropped before decoding
+  kDrop,
+  /// \brief Frames are published with their FFC state in thermal_raw
+  kFlag,
+};
+
+/// \brief Parses an FFC policy name, drop or flag
+/// \return false when the name is unknown
+bool parse_ffc_policy(const std::string & name, FfcPolicy & policy);
+
+/// \brief The fields of telemetry row A the node uses
+struct Telemetry
+{
+  /// \brief Milliseconds since the camera powered up
+  uint32_t time_counter_ms = 0;
+  /// \brief Status bits, see the Lepton datasheet
+  uint32_t status = 0;
+  /// \brief Number of frames the camera produced, including those it did not send
+  uint32_t frame_counter = 0;
+  /// \brief Focal plane array temperature in centikelvin
+  uint16_t fpa_temperature = 0;
+  /// \brief Housing temperature in centikelvin
+  uint16_t housing_temperature = 0;
+  FfcState ffc_state = FfcState::kNever;
+  /// \brief The camera wants a flat-field correction, bit 3 of the status word
+  bool ffc_desired = false;
+
+  /// \brief Whether the frame was taken with the shutter closed
+  bool during_ffc() const
+  {
+    return ffc_state == FfcState::kImminent || ffc_state == FfcState::kInProgress;
+  }
+};
+
+/// \brief Reads telemetry row A of a frame
+/// \param frame Complete frame, its layout tells where the telemetry is
+/// \param telemetry Parsed fields
+/// \return false when the layout of the frame carries no telemetry
+bool parse_telemetry(const Frame & frame, Telemetry & telemetry);
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__TELEMETRY_HPP_
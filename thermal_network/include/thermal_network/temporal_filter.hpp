@@ -0,0 +1,76 @@
+/// \file Temporal denoising
+/// \brief Per-pixel smoothing of consecutive raw frames, in place on the decoded buffer
+///
+/// All history is allocated when the filter is constructed. The moving average keeps one float
+/// per pixel, the median keeps the last frames in a ring of raw frames. Medians of 3 and 5
+/// frames use min/max networks over whole frames, loops the compiler turns into vector min/max
+/// instructions, other sizes fall back to a per-pixel selection.
+
+#ifndef THERMAL_NETWORK__TEMPORAL_FILTER_HPP_
+#define THERMAL_NETWORK__TEMPORAL_FILTER_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "thermal_network/frame_decoder.hpp"
+
+namespace thermal_network
+{
+
+/// \brief Smoothing applied to consecutive frames
+enum class FilterMode
+{
+  kNone,
+  kEma,     /// Exponential moving average with alpha = 2 / (frames + 1)
+  kMedian,  /// Median of the last frames
+};
+
+/// \brief Parses none, ema or median
+/// \return false when the name is unknown
+bool parse_filter_mode(const std::string & name, FilterMode & mode);
+
+class TemporalFilter
+{
+/// \brief Smooths each pixel over the last frames
+
+public:
+  /// \brief Allocates the history
+  /// \param mode Smoothing to apply
+  /// \param frames Number of frames the smoothing spans, at least 1
+  explicit TemporalFilter(FilterMode mode = FilterMode::kNone, std::size_t frames = 3);
+
+  /// \brief Whether apply() changes anything
+  bool enabled() const {return mode_ != FilterMode::kNone && frames_ > 1;}
+
+  /// \brief Adds a frame to the history and replaces it by the filtered frame
+  ///
+  /// The first frame after construction or reset() fills the whole history, so the output
+  /// does not ramp up from zero. The range of raw is recomputed from the filtered pixels.
+  /// \param raw Decoded frame without zero pixels, filtered in place
+  void apply(RawFrame & raw);
+
+  /// \brief Forgets the history, for instance after frames were skipped
+  void reset() {primed_ = false;}
+
+private:
+  using Pixels = std::array<uint16_t, kFramePixels>;
+
+  FilterMode mode_;
+  std::size_t frames_;
+  bool primed_ = false;
+
+  std::vector<float> average_;
+  std::vector<Pixels> history_;
+  std::size_t newest_ = 0;
+  std::vector<uint16_t> values_;  // Scratch of the generic median
+
+  void apply_ema(Pixels & pixels, std::size_t count);
+  void apply_median(Pixels & pixels, std::size_t count);
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__TEMPORAL_FILTER_HPP_
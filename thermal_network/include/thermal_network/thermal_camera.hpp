@@ -0,0 +1,348 @@
+/// \file Per-camera pipeline
+/// \brief Socket, frame assembly, decode buffers and publishers of one Lepton stream
+///
+/// A camera is fed by the receive thread, which calls receive() when its socket is readable,
+/// and drained by exactly one worker of the pool, which calls process(). Nothing else is shared
+/// between the cameras of a node apart from the active palette.
+
+#ifndef THERMAL_NETWORK__THERMAL_CAMERA_HPP_
+#define THERMAL_NETWORK__THERMAL_CAMERA_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "diagnostic_msgs/msg/diagnostic_status.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_lifecycle/lifecycle_node.hpp"
+#include "sensor_msgs/msg/image.hpp"
+#include "thermal_network/msg/thermal_data.hpp"
+#include "thermal_network/msg/thermal_heartbeat.hpp"
+#include "thermal_network/msg/thermal_raw.hpp"
+#include "thermal_network/msg/thermal_stats.hpp"
+#include "thermal_network/change_detector.hpp"
+#include "thermal_network/colormap.hpp"
+#include "thermal_network/compressed_publisher.hpp"
+#include "thermal_network/frame_assembler.hpp"
+#include "thermal_network/frame_decoder.hpp"
+#include "thermal_network/histogram_agc.hpp"
+#include "thermal_network/image_encoder.hpp"
+#include "thermal_network/latency_histogram.hpp"
+#include "thermal_network/lepton.hpp"
+#include "thermal_network/output_throttle.hpp"
+#include "thermal_network/pixel_calibration.hpp"
+#include "thermal_network/segment_recording.hpp"
+#include "thermal_network/spsc_frame_queue.hpp"
+#include "thermal_network/telemetry.hpp"
+#include "thermal_network/temporal_filter.hpp"
+#include "thermal_network/udp_receiver.hpp"
+
+#ifdef THERMAL_NETWORK_HAS_CUDA
+#include "thermal_network/cuda_image.hpp"
+#endif
+
+namespace thermal_network
+{
+
+/// \brief Pixel format of thermal_image
+enum class ImageEncoding
+{
+  kRgb8,    /// Colormapped by the node
+  kMono8,   /// Palette index, subscribers apply the palette
+  kMono16,  /// Raw centikelvin
+};
+
+/// \brief Parses rgb8, mono8 or mono16
+/// \return false when the name is unknown
+bool parse_image_encoding(const std::string & name, ImageEncoding & encoding);
+
+/// \brief Settings of one camera
+struct CameraOptions
+{
+  /// \brief Namespace of the camera topics, empty publishes on the topics of the node itself
+  std::string name;
+  UdpReceiver::Options receiver;
+  /// \brief Frame layout of the sensor, index into kSensorGeometries
+  std::size_t geometry = kDefaultSensorGeometry;
+  /// \brief Sensor model put into the raw messages
+  std::string sensor = "lepton3.1r";
+  /// \brief Time between the capture and the reception of a frame, subtracted from its stamp
+  int64_t latency_offset_ns = 0;
+  /// \brief Time within which all segments of a frame have to arrive
+  int64_t frame_timeout_ns = 200000000;
+  /// \brief Number of complete frames that can wait for the worker
+  std::size_t queue_size = 4;
+  DropPolicy drop_policy = DropPolicy::kDropOldest;
+  bool auto_range_min = false;
+  bool auto_range_max = false;
+  /// \brief Fixed colormap range in centikelvin (temp / 100 - 273 celsius)
+  uint16_t range_min = 27300;
+  uint16_t range_max = 31500;
+  /// \brief Map the image by histogram equalization instead of the linear range
+  bool histogram_agc = false;
+  /// \brief Percentage of the pixels saturating at each end with histogram_agc
+  double agc_clip_percent = 0.5;
+  /// \brief Frames sent during a flat-field correction, only known with telemetry
+  FfcPolicy ffc_policy = FfcPolicy::kDrop;
+  /// \brief Per-pixel correction applied right after decoding, nullptr for none
+  std::shared_ptr<const PixelCalibration> calibration;
+  /// \brief Denoising applied between decoding and all outputs
+  FilterMode filter_mode = FilterMode::kNone;
+  /// \brief Number of frames the denoising spans
+  std::size_t filter_frames = 3;
+  ImageEncoding image_encoding = ImageEncoding::kRgb8;
+  OutputThrottle raw_throttle;
+  OutputThrottle temperature_throttle;
+  OutputThrottle image_throttle;
+  OutputThrottle stats_throttle;
+  OutputThrottle compressed_throttle;
+  /// \brief Format of thermal_image/compressed
+  ImageCodec compressed_codec = ImageCodec::kPng;
+  /// \brief JPEG quality or PNG zlib level, see encode_image()
+  int compressed_quality = 6;
+  /// \brief Regions whose statistics are published next to those of the whole frame
+  std::vector<Region> rois;
+  /// \brief Regions published as raw frames of their own on thermal_crop/<name>
+  std::vector<Region> crops;
+  OutputThrottle crop_throttle;
+  /// \brief Block size of the downscaled thermal_preview, 0 does not publish it
+  std::size_t preview_factor = 0;
+  PoolMode preview_mode = PoolMode::kMean;
+  OutputThrottle preview_throttle;
+  /// \brief Publish the frame outputs only when the scene changed, a heartbeat otherwise
+  bool change_detection = false;
+  ChangeDetector::Options change_detector;
+  /// \brief Time between heartbeats while no frame is published
+  int64_t heartbeat_interval_ns = 1000000000;
+  /// \brief Time after which a frame is published even though the scene did not change, so
+  /// that late subscribers get a frame, 0 never publishes unchanged frames
+  int64_t keyframe_interval_ns = 10000000000;
+  /// \brief Publish reused, pre-sized messages without intra-process comms so that publishing
+  /// allocates nothing once the first frames went out, thermal_image/cuda excepted, its
+  /// allocations are not counted
+  bool allocation_free = false;
+  /// \brief Also map the frames onto the palette on the GPU and publish the device buffers on
+  /// thermal_image/cuda, only in builds with THERMAL_NETWORK_CUDA
+  bool cuda = false;
+  OutputThrottle cuda_throttle;
+};
+
+class ThermalCamera
+{
+/// \brief Turns the segments of one camera into ROS messages
+
+public:
+  /// \brief Creates the publishers, the socket is opened by open()
+  /// \param node Node the publishers are created on, it has to outlive the camera
+  /// \param options Settings of the camera
+  /// \param palette Palette the image is rendered with, may change while running
+  ThermalCamera(
+    rclcpp_lifecycle::LifecycleNode & node, const CameraOptions & options,
+    const std::atomic<Palette> & palette);
+
+  ThermalCamera(const ThermalCamera &) = delete;
+  ThermalCamera & operator=(const ThermalCamera &) = delete;
+
+  /// \brief Opens the socket and logs the outcome
+  /// \return false on failure
+  bool open();
+
+  /// \brief Closes the socket and drops the frame being assembled, receive thread only
+  void close();
+
+  /// \brief Closes the socket and binds it again, after it failed, receive thread only
+  /// \return false when the socket could not be opened, the camera stays closed then
+  bool reopen();
+
+  /// \brief Socket to poll, -1 while closed
+  int fd() const {return receiver_.fd();}
+
+  /// \brief Namespace of the camera, empty for the default camera
+  const std::string & name() const {return options_.name;}
+
+  /// \brief Reads the queued datagrams and queues the frames they complete, receive thread only
+  /// \return Number of frames queued, or -1 when the socket failed
+  int receive();
+
+  /// \brief Queues the frame a replayed segment completes, replay thread only
+  /// \param record Segment as recorded
+  /// \param stamp_ns Time the frame of the segment is stamped with
+  /// \return 1 when a frame was queued, 0 otherwise
+  int replay(const SegmentRecord & record, int64_t stamp_ns);
+
+  /// \brief Whether the next frame would push a queued one out, receive or replay thread only
+  bool queue_full() const {return queue_.full();}
+
+  /// \brief Records every received datagram from now on, receive thread only
+  /// \param recorder Recording shared by all cameras, nullptr stops recording
+  /// \param stream Number of the camera in the recording
+  void set_recorder(SegmentRecorder * recorder, uint16_t stream);
+
+  /// \brief Decodes and publishes all queued frames, called by one worker only
+  void process();
+
+  /// \brief Status of the pipeline since the previous call, diagnostics timer only
+  diagnostic_msgs::msg::DiagnosticStatus diagnostics();
+
+private:
+  rclcpp_lifecycle::LifecycleNode & node_;
+  CameraOptions options_;
+  const std::atomic<Palette> & palette_;
+  std::string frame_id_;
+
+  UdpReceiver receiver_;
+  FrameAssembler assembler_;
+  SpscFrameQueue<Frame> queue_;
+  SegmentRecorder * recorder_ = nullptr;
+  uint16_t stream_ = 0;
+
+  int myImageWidth_;
+  int myImageHeight_;
+  ChangeDetector change_detector_;
+  int64_t last_keyframe_ns_ = 0;
+  int64_t last_heartbeat_ns_ = 0;
+  uint32_t frames_since_change_ = 0;
+  uint16_t minValue_;
+  uint16_t maxValue_;
+  float diff_;
+  float scale_;
+  RawFrame raw_frame_;
+  RawFrame resampled_frame_;  // Crop or preview being published
+  /// \brief Telemetry of the frame being processed, has_telemetry_ tells whether there is any
+  Telemetry telemetry_;
+  bool has_telemetry_ = false;
+  TemporalFilter filter_;
+  ColormapLut colormap_;
+  HistogramAgc agc_;
+  std::vector<uint8_t> agc_index_;
+  uint16_t agc_first_ = 0;  // Raw value of agc_index_[0]
+  std::vector<uint8_t> index_;  // Palette indices handed to the compressed publisher
+
+  // Reused for every frame with allocation_free
+  thermal_network::msg::ThermalRaw raw_msg_;
+  thermal_network::msg::ThermalData temperature_msg_;
+  sensor_msgs::msg::Image image_msg_;
+  thermal_network::msg::ThermalStats stats_msg_;
+  std::vector<thermal_network::msg::ThermalRaw> crop_msgs_;
+  thermal_network::msg::ThermalRaw preview_msg_;
+  thermal_network::msg::ThermalHeartbeat heartbeat_msg_;
+
+  std::atomic<uint64_t> n_zero_value_drop_frame_{0};
+  std::atomic<uint64_t> ffc_frames_{0};
+  std::atomic<uint64_t> unchanged_frames_{0};
+  std::atomic<uint64_t> heartbeats_{0};
+  std::atomic<uint32_t> sensor_frame_counter_{0};
+  std::atomic<uint64_t> frames_received_{0};
+  std::atomic<uint64_t> frames_decoded_{0};
+  std::atomic<uint64_t> frames_skipped_{0};  // No subscribers or throttled
+  std::atomic<uint64_t> raw_stage_runs_{0};
+  std::atomic<uint64_t> temperature_stage_runs_{0};
+  std::atomic<uint64_t> image_stage_runs_{0};
+  std::atomic<uint64_t> stats_stage_runs_{0};
+  std::atomic<uint64_t> compressed_stage_runs_{0};
+  std::atomic<uint64_t> crop_stage_runs_{0};
+  std::atomic<uint64_t> preview_stage_runs_{0};
+  std::atomic<uint64_t> cuda_stage_runs_{0};
+  std::atomic<uint64_t> truncated_segments_{0};
+  std::atomic<uint64_t> receive_errors_{0};
+  std::atomic<uint64_t> socket_reopens_{0};
+  std::atomic<uint64_t> receive_allocations_{0};
+  std::atomic<uint64_t> worker_allocations_{0};
+  uint64_t cuda_allocations_ = 0;  // Left out of worker_allocations_, worker thread only
+  uint64_t last_frames_received_ = 0;
+  uint64_t last_frames_decoded_ = 0;
+  uint64_t last_frames_skipped_ = 0;
+  std::array<uint64_t, 8> last_stage_runs_{};
+  uint32_t last_overruns_ = 0;
+
+  // Steady clock durations of each stage, the frame latency runs from the receive stamp to the
+  // end of publishing on the system clock
+  LatencyHistogram receive_latency_;
+  LatencyHistogram reassembly_latency_;
+  LatencyHistogram decode_latency_;
+  LatencyHistogram colorize_latency_;
+  LatencyHistogram publish_latency_;
+  LatencyHistogram frame_latency_;
+
+  rclcpp::Publisher<thermal_network::msg::ThermalData>::SharedPtr thermal_pub_;
+  rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr img_pub_;
+  rclcpp::Publisher<thermal_network::msg::ThermalRaw>::SharedPtr raw_pub_;
+  rclcpp::Publisher<thermal_network::msg::ThermalStats>::SharedPtr stats_pub_;
+  std::vector<rclcpp::Publisher<thermal_network::msg::ThermalRaw>::SharedPtr> crop_pubs_;
+  rclcpp::Publisher<thermal_network::msg::ThermalRaw>::SharedPtr preview_pub_;
+  rclcpp::Publisher<thermal_network::msg::ThermalHeartbeat>::SharedPtr heartbeat_pub_;
+  std::unique_ptr<CompressedPublisher> compressed_pub_;
+#ifdef THERMAL_NETWORK_HAS_CUDA
+  CudaRenderer cuda_renderer_;
+  rclcpp::Publisher<CudaImage>::SharedPtr cuda_pub_;
+#endif
+
+  /// \brief Message to reuse for an output, nullptr unless allocation_free
+  template<typename MessageT>
+  MessageT * reusable(MessageT & msg) {return options_.allocation_free ? &msg : nullptr;}
+
+  /// \brief Topic name inside the namespace of the camera
+  std::string topic(const std::string & name) const;
+
+  /// \brief Adds a segment to the frame being assembled and queues the frame it completes
+  /// \return true when a frame was queued
+  bool assemble(
+    const uint8_t * data, std::size_t size, bool truncated, int64_t stamp_ns, int64_t now_ns);
+
+  /// \brief Recomputes the colormap scale from the current range
+  void update_scale();
+
+  /// \brief Processes one frame and publishes the outputs that are due
+  void process_data(const Frame & frame);
+
+  /// \brief Publishes a frame as raw centikelvin values
+  /// \param publisher Topic to publish on
+  /// \param reusable Message to reuse, see reusable()
+  /// \param raw Frame to publish, the decoded one or a crop or preview of it
+  void publish_raw_frame(
+    const rclcpp::Publisher<thermal_network::msg::ThermalRaw>::SharedPtr & publisher,
+    thermal_network::msg::ThermalRaw * reusable, const RawFrame & raw,
+    const rclcpp::Time & stamp);
+
+  /// \brief Publishes the decoded frame as raw centikelvin values
+  void publish_raw(const rclcpp::Time & stamp);
+
+  /// \brief Publishes the crops whose topics have subscribers
+  void publish_crops(const rclcpp::Time & stamp);
+
+  /// \brief Publishes the downscaled frame
+  void publish_preview(const rclcpp::Time & stamp);
+
+  /// \brief Publishes that the camera runs but its scene did not change
+  void publish_heartbeat(const rclcpp::Time & stamp);
+
+  /// \brief Publishes the decoded frame as temperatures in Celsius
+  void publish_temperature(const rclcpp::Time & stamp);
+
+  /// \brief Publishes the statistics of the decoded frame and of the regions of interest
+  void publish_stats(const rclcpp::Time & stamp);
+
+  /// \brief Applies the palette and the range or histogram of the decoded frame to the colormap
+  void update_colormap();
+
+  /// \brief Colorizes the decoded frame and publishes it as an image
+  /// \param colorize_start_ns Steady clock time the colorize stage started at
+  void publish_image(const rclcpp::Time & stamp, int64_t colorize_start_ns);
+
+  /// \brief Hands the palette indices of the decoded frame to the compressed publisher
+  void publish_compressed(const rclcpp::Time & stamp);
+
+  /// \brief Whether thermal_image/cuda has subscribers, always false without CUDA
+  bool has_cuda_subscribers() const;
+
+  /// \brief Renders the decoded frame on the GPU and publishes its device buffers
+  void publish_cuda(const rclcpp::Time & stamp);
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__THERMAL_CAMERA_HPP_
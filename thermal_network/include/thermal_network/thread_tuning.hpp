@@ -0,0 +1,44 @@
+/// \file Real-time thread settings
+/// \brief SCHED_FIFO priority, CPU affinity and memory locking for the hot-path threads
+///
+/// Both need privileges, CAP_SYS_NICE or an rtprio limit for the priority and CAP_IPC_LOCK or a
+/// large enough memlock limit for locking. Failing to apply them is reported, not fatal, so the
+/// node still runs on a development machine.
+
+#ifndef THERMAL_NETWORK__THREAD_TUNING_HPP_
+#define THERMAL_NETWORK__THREAD_TUNING_HPP_
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace thermal_network
+{
+
+/// \brief Scheduling of a thread
+struct ThreadTuning
+{
+  /// \brief SCHED_FIFO priority from 1 to 99, 0 keeps the default time-sharing policy
+  int priority = 0;
+  /// \brief CPUs the thread may run on, empty for all
+  std::vector<int> cpus;
+
+  /// \brief Whether anything differs from the defaults
+  bool enabled() const {return priority > 0 || !cpus.empty();}
+};
+
+/// \brief Applies scheduling settings to a running thread
+/// \param thread Thread to change
+/// \param tuning Settings, a default one changes nothing
+/// \param error Description of the failures, empty on success
+/// \return false when a setting could not be applied, the others still are
+bool apply_thread_tuning(std::thread & thread, const ThreadTuning & tuning, std::string & error);
+
+/// \brief Locks all current and future pages of the process into memory
+/// \param error Description of the failure, empty on success
+/// \return false when the pages could not be locked
+bool lock_memory(std::string & error);
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__THREAD_TUNING_HPP_
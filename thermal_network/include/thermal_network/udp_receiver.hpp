@@ -0,0 +1,130 @@
+/// \file Batched UDP receive engine
+/// \brief Drains the socket with recvmmsg into a preallocated ring of segment slots
+
+#ifndef THERMAL_NETWORK__UDP_RECEIVER_HPP_
+#define THERMAL_NETWORK__UDP_RECEIVER_HPP_
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "thermal_network/lepton.hpp"
+
+namespace thermal_network
+{
+
+/// \brief One received datagram
+struct SegmentSlot
+{
+  std::array<uint8_t, kSegmentBytes> data;
+  /// \brief Number of valid bytes in data
+  std::size_t size = 0;
+  /// \brief Datagram was larger than the slot and got cut
+  bool truncated = false;
+  /// \brief Receive time in nanoseconds since the epoch, from the kernel when kernel timestamps
+  /// are enabled, otherwise the time recvmmsg returned
+  int64_t stamp_ns = 0;
+};
+
+class UdpReceiver
+{
+/// \brief Receives Lepton segments from a UDP socket in batches
+
+public:
+  struct Options
+  {
+    /// \brief UDP port to bind to
+    uint16_t port = 8080;
+    /// \brief IPv4 multicast group to join and bind to, empty receives unicast on any address
+    std::string multicast_group;
+    /// \brief Interface the group is joined on, by address or by name, empty lets the routing
+    /// table choose
+    std::string multicast_interface;
+    /// \brief Set SO_REUSEPORT, so that other sockets, in this or another process, can bind the
+    /// same port, unicast datagrams are then spread over them by source
+    bool reuse_port = false;
+    /// \brief Requested SO_RCVBUF size in bytes, 0 keeps the system default
+    int receive_buffer_bytes = 0;
+    /// \brief Request kernel receive timestamps through SO_TIMESTAMPNS, software stamps in
+    /// CLOCK_REALTIME
+    bool kernel_timestamps = true;
+    /// \brief Maximum number of datagrams read by one recvmmsg call
+    std::size_t batch_size = 16;
+    /// \brief Number of slots in the ring, a received slot stays valid for this many datagrams
+    std::size_t ring_size = 64;
+  };
+
+  /// \brief Preallocates the ring, the socket is created by open()
+  explicit UdpReceiver(const Options & options);
+
+  /// \brief Closes the socket
+  ~UdpReceiver();
+
+  UdpReceiver(const UdpReceiver &) = delete;
+  UdpReceiver & operator=(const UdpReceiver &) = delete;
+
+  /// \brief Creates, configures and binds the socket, joining the multicast group if any
+  /// \return false on failure, see error()
+  bool open();
+
+  /// \brief Closes the socket
+  void close();
+
+  /// \brief Reads the datagrams that are queued on the socket
+  /// \param wait Block until at least one datagram arrives, otherwise return 0 right away when
+  ///     none is queued, for sockets polled by epoll
+  /// \return Number of datagrams received, or -1 on failure, see error()
+  int receive_batch(bool wait = true);
+
+  /// \brief Datagram of the last batch
+  /// \param index Position in the last batch, from 0 to the value returned by receive_batch()
+  const SegmentSlot & received(std::size_t index) const
+  {
+    return ring_[(batch_start_ + index) % ring_.size()];
+  }
+
+  /// \brief Socket descriptor, -1 while closed
+  int fd() const {return sockfd_;}
+
+  /// \brief Socket receive buffer size granted by the kernel
+  int receive_buffer_bytes() const {return granted_receive_buffer_bytes_;}
+
+  /// \brief Whether kernel timestamps were enabled on the socket
+  bool kernel_timestamps() const {return kernel_timestamps_enabled_;}
+
+  /// \brief Number of datagrams the kernel dropped because the receive buffer was full, over
+  /// every socket opened so far, wraps around
+  uint32_t overruns() const {return overruns_.load(std::memory_order_relaxed);}
+
+  /// \brief Description of the last failure
+  const std::string & error() const {return error_;}
+
+private:
+  Options options_;
+  int sockfd_ = -1;
+  std::string error_;
+  int granted_receive_buffer_bytes_ = 0;
+  bool kernel_timestamps_enabled_ = false;
+  std::atomic<uint32_t> overruns_{0};  // Read by the diagnostics
+  uint32_t overruns_base_ = 0;  // overruns_ when the socket was opened
+
+  std::vector<SegmentSlot> ring_;
+  std::size_t head_ = 0;
+  std::size_t batch_start_ = 0;
+
+  std::vector<struct mmsghdr> msgs_;
+  std::vector<struct iovec> iovs_;
+  std::vector<std::array<char, 256>> control_;
+
+  void set_error(const std::string & what);
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__UDP_RECEIVER_HPP_
@@ -0,0 +1,86 @@
+/// \file Fixed-size pool of processing threads
+/// \brief Runs registered work on a few threads, each piece of work always on the same thread
+///
+/// Every piece of work belongs to exactly one worker, so the frame queue of a camera keeps a
+/// single consumer no matter how many cameras share the pool. A worker sleeps on its own
+/// semaphore and runs all of its work once it is notified or a timeout expires.
+
+#ifndef THERMAL_NETWORK__WORKER_POOL_HPP_
+#define THERMAL_NETWORK__WORKER_POOL_HPP_
+
+#include <semaphore.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thermal_network/thread_tuning.hpp"
+
+namespace thermal_network
+{
+
+class WorkerPool
+{
+/// \brief Shares a fixed number of threads between the cameras
+
+public:
+  /// \brief Creates the workers, their threads are started by start()
+  /// \param threads Number of worker threads, at least 1
+  /// \param timeout Time after which a worker runs its work even without a notification
+  explicit WorkerPool(
+    std::size_t threads,
+    std::chrono::nanoseconds timeout = std::chrono::milliseconds(100));
+
+  /// \brief Stops the threads
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool & operator=(const WorkerPool &) = delete;
+
+  /// \brief Registers work, only before start()
+  /// \param work Called by its worker whenever the worker wakes up
+  /// \return Worker the work was given to, pass it to notify()
+  std::size_t add(std::function<void()> work);
+
+  /// \brief Starts the worker threads
+  void start();
+
+  /// \brief Applies scheduling settings to all worker threads, only after start()
+  /// \param tuning Settings of every worker
+  /// \param error Description of the failures, empty on success
+  /// \return false when a setting could not be applied
+  bool tune(const ThreadTuning & tuning, std::string & error);
+
+  /// \brief Stops and joins the worker threads, work that is running finishes first
+  void stop();
+
+  /// \brief Wakes a worker up
+  void notify(std::size_t worker);
+
+  /// \brief Number of worker threads
+  std::size_t size() const {return workers_.size();}
+
+private:
+  struct Worker
+  {
+    sem_t wakeup;
+    std::vector<std::function<void()>> work;
+    std::thread thread;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::chrono::nanoseconds timeout_;
+  std::size_t next_worker_ = 0;
+  std::atomic<bool> running_{false};
+
+  void run(Worker & worker);
+};
+
+}  // namespace thermal_network
+
+#endif  // THERMAL_NETWORK__WORKER_POOL_HPP_
@@ -0,0 +1,34 @@
+/// \file Heap allocation counting
+/// \brief Looks up the counter of the preloaded counting library
+
+#include "thermal_network/allocation_counter.hpp"
+
+#include <dlfcn.h>
+
+namespace thermal_network
+{
+
+namespace
+{
+using CounterFunction = uint64_t (*)();
+
+CounterFunction counter()
+{
+  static const CounterFunction function = reinterpret_cast<CounterFunction>(
+    dlsym(RTLD_DEFAULT, "thermal_network_thread_allocations"));
+  return function;
+}
+}  // namespace
+
+bool allocation_counting_available()
+{
+  return counter() != nullptr;
+}
+
+uint64_t thread_allocations()
+{
+  CounterFunction function = counter();
+  return function != nullptr ? function() : 0;
+}
+
+}  // namespace thermal_network
@@ -0,0 +1,117 @@
+/// \file Heap allocation counting
+/// \brief Replacement of the global operator new that counts the allocations of each thread
+///
+/// Usage: LD_PRELOAD=libthermal_network_allocation_counter.so ros2 run thermal_network ...
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+thread_local uint64_t allocations = 0;
+
+void * allocate(std::size_t size)
+{
+  allocations++;
+  if (void * pointer = std::malloc(size == 0 ? 1 : size)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void * allocate_aligned(std::size_t size, std::align_val_t alignment)
+{
+  allocations++;
+  void * pointer = nullptr;
+  const std::size_t align = std::max(static_cast<std::size_t>(alignment), sizeof(void *));
+  if (posix_memalign(&pointer, align, size == 0 ? 1 : size) != 0) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+}  // namespace
+
+extern "C" __attribute__((visibility("default"))) uint64_t thermal_network_thread_allocations()
+{
+  return allocations;
+}
+
+void * operator new(std::size_t size)
+{
+  return allocate(size);
+}
+
+void * operator new[](std::size_t size)
+{
+  return allocate(size);
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+  try {
+    return allocate(size);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+  try {
+    return allocate(size);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+  return allocate_aligned(size, alignment);
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return allocate_aligned(size, alignment);
+}
+
+void operator delete(void * pointer) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete[](void * pointer) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete(void * pointer, std::size_t) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete[](void * pointer, std::size_t) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete(void * pointer, std::align_val_t) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete[](void * pointer, std::align_val_t) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete(void * pointer, std::size_t, std::align_val_t) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete[](void * pointer, std::size_t, std::align_val_t) noexcept
+{
+  std::free(pointer);
+}
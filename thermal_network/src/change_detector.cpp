@@ -0,0 +1,77 @@
+/// \file Scene change detection
+/// \brief Implementation of ChangeDetector
+
+#include "thermal_network/change_detector.hpp"
+
+#include <algorithm>
+
+namespace thermal_network
+{
+
+ChangeDetector::ChangeDetector(const Options & options, std::size_t width, std::size_t height)
+: options_(options),
+  width_(width),
+  height_(height)
+{
+  options_.block_size = std::max<std::size_t>(options_.block_size, 1);
+  options_.min_blocks = std::max<std::size_t>(options_.min_blocks, 1);
+  const std::size_t size = options_.block_size;
+  columns_ = (width_ + size - 1) / size;
+  rows_ = (height_ + size - 1) / size;
+  sums_.resize(columns_ * rows_);
+  reference_.resize(columns_ * rows_);
+  areas_.resize(columns_ * rows_);
+  for (std::size_t r = 0; r < rows_; ++r) {
+    for (std::size_t c = 0; c < columns_; ++c) {
+      areas_[r * columns_ + c] = static_cast<uint32_t>(
+        (std::min(width_, (c + 1) * size) - c * size) *
+        (std::min(height_, (r + 1) * size) - r * size));
+    }
+  }
+}
+
+bool ChangeDetector::compare(const RawFrame & raw)
+{
+  // Rows are summed in order into the sums of their block row, whole blocks at a time
+  const std::size_t size = options_.block_size;
+  const std::size_t width = std::min(width_, raw.width);
+  const std::size_t height = std::min(height_, raw.height);
+  std::fill(sums_.begin(), sums_.end(), 0);
+  for (std::size_t y = 0; y < height; ++y) {
+    const uint16_t * row = raw.pixels.data() + y * raw.width;
+    uint32_t * sums = sums_.data() + (y / size) * columns_;
+    for (std::size_t c = 0; c < columns_; ++c) {
+      const std::size_t end = std::min(width, (c + 1) * size);
+      uint32_t sum = 0;
+      for (std::size_t x = c * size; x < end; ++x) {
+        sum += row[x];
+      }
+      sums[c] += sum;
+    }
+  }
+
+  changed_blocks_ = 0;
+  max_delta_ = 0.0;
+  if (!has_reference_) {
+    changed_blocks_ = sums_.size();
+    return true;
+  }
+  for (std::size_t b = 0; b < sums_.size(); ++b) {
+    const uint32_t difference =
+      sums_[b] > reference_[b] ? sums_[b] - reference_[b] : reference_[b] - sums_[b];
+    // Compared on the sums, so the block means are never divided out
+    if (difference > static_cast<uint64_t>(options_.threshold) * areas_[b]) {
+      changed_blocks_++;
+    }
+    max_delta_ = std::max(max_delta_, static_cast<double>(difference) / areas_[b]);
+  }
+  return changed_blocks_ >= options_.min_blocks;
+}
+
+void ChangeDetector::update_reference()
+{
+  reference_ = sums_;
+  has_reference_ = true;
+}
+
+}  // namespace thermal_network
@@ -0,0 +1,92 @@
+/// \file Background image compression
+/// \brief Implementation of CompressedPublisher
+
+#include "thermal_network/compressed_publisher.hpp"
+
+#include <memory>
+#include <utility>
+
+namespace thermal_network
+{
+
+CompressedPublisher::CompressedPublisher(
+  rclcpp_lifecycle::LifecycleNode & node, const std::string & topic, const std::string & frame_id,
+  ImageCodec codec, int quality)
+: logger_(node.get_logger()),
+  frame_id_(frame_id),
+  codec_(codec),
+  quality_(quality)
+{
+  publisher_ = rclcpp::create_publisher<sensor_msgs::msg::CompressedImage>(node, topic, 10);
+  thread_ = std::thread(&CompressedPublisher::run, this);
+}
+
+CompressedPublisher::~CompressedPublisher()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  wakeup_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool CompressedPublisher::has_subscribers() const
+{
+  return publisher_->get_subscription_count() > 0 ||
+         publisher_->get_intra_process_subscription_count() > 0;
+}
+
+void CompressedPublisher::submit(
+  const uint8_t * index, std::size_t width, std::size_t height, Palette palette,
+  const rclcpp::Time & stamp)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (has_pending_) {
+      replaced_++;
+    }
+    pending_.index.assign(index, index + width * height);
+    pending_.width = width;
+    pending_.height = height;
+    pending_.palette = palette;
+    pending_.stamp = stamp;
+    has_pending_ = true;
+  }
+  wakeup_.notify_one();
+}
+
+void CompressedPublisher::run()
+{
+  Job job;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wakeup_.wait(lock, [this]() {return has_pending_ || !running_;});
+      if (!running_) {
+        return;
+      }
+      // Swapping keeps both buffers allocated, submit() only copies into the spare one
+      std::swap(job, pending_);
+      has_pending_ = false;
+    }
+
+    auto msg = std::make_unique<sensor_msgs::msg::CompressedImage>();
+    if (!encode_image(
+        codec_, job.index.data(), job.width, job.height, palette_colors(job.palette), quality_,
+        msg->data))
+    {
+      RCLCPP_WARN_STREAM_THROTTLE(
+        logger_, clock_, 5000, "Encoding " << image_codec_name(codec_) << " image failed");
+      continue;
+    }
+    msg->header.stamp = job.stamp;
+    msg->header.frame_id = frame_id_;
+    msg->format = compressed_image_format(codec_);
+    publisher_->publish(std::move(msg));
+  }
+}
+
+}  // namespace thermal_network
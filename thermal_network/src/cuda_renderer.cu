@@ -0,0 +1,227 @@
+/// \file CUDA rendering
+/// \brief Implementation of CudaRenderer
+
+#include "thermal_network/cuda_renderer.hpp"
+
+#include <cuda_runtime.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace thermal_network
+{
+
+namespace
+{
+
+/// \brief Palette the kernel reads the colors from
+__constant__ uint8_t palette_device[256 * 3];
+
+constexpr unsigned int kBlockSize = 256;
+
+/// \brief Colormap of one launch, the mapping is in device memory
+struct MappingArgs
+{
+  const uint8_t * mapping;
+  uint16_t first;
+  uint16_t top;
+};
+
+/// \brief One thread per pixel, the arithmetic is that of normalize() and to_celsius()
+///
+/// Built without fused multiply-add so that the indices and temperatures match the CPU
+/// kernels bit for bit.
+__global__ void render_kernel(
+  const uint16_t * raw, std::size_t count, uint16_t min, uint16_t max, float scale,
+  MappingArgs mapping, uint8_t * rgb, float * celsius)
+{
+  const std::size_t i = static_cast<std::size_t>(blockIdx.x) * blockDim.x + threadIdx.x;
+  if (i >= count) {
+    return;
+  }
+  const uint16_t value = raw[i];
+  uint8_t index;
+  if (mapping.mapping != nullptr) {
+    const uint16_t clamped = value < mapping.first ? mapping.first :
+      value > mapping.top ? mapping.top : value;
+    index = mapping.mapping[clamped - mapping.first];
+  } else if (value <= min) {
+    index = 0;
+  } else if (value >= max) {
+    index = 255;
+  } else {
+    index = static_cast<uint8_t>(fminf(static_cast<float>(value - min) * scale, 255.0f));
+  }
+  rgb[i * 3 + 0] = palette_device[index * 3 + 0];
+  rgb[i * 3 + 1] = palette_device[index * 3 + 1];
+  rgb[i * 3 + 2] = palette_device[index * 3 + 2];
+  celsius[i] = static_cast<float>((value / 100.0) - 273.0);
+}
+
+}  // namespace
+
+CudaFrame::~CudaFrame()
+{
+  cudaFree(raw);
+  cudaFree(rgb);
+  cudaFree(celsius);
+}
+
+bool CudaFrame::allocate(std::size_t frame_width, std::size_t frame_height)
+{
+  width = frame_width;
+  height = frame_height;
+  const std::size_t pixels = size();
+  return cudaMalloc(&raw, pixels * sizeof(uint16_t)) == cudaSuccess &&
+         cudaMalloc(&rgb, pixels * 3) == cudaSuccess &&
+         cudaMalloc(&celsius, pixels * sizeof(float)) == cudaSuccess;
+}
+
+bool download_rgb(const CudaFrame & frame, uint8_t * rgb)
+{
+  return cudaMemcpy(rgb, frame.rgb, frame.size() * 3, cudaMemcpyDeviceToHost) == cudaSuccess;
+}
+
+bool upload_rgb(const uint8_t * rgb, CudaFrame & frame)
+{
+  return cudaMemcpy(frame.rgb, rgb, frame.size() * 3, cudaMemcpyHostToDevice) == cudaSuccess &&
+         cudaMemset(frame.raw, 0, frame.size() * sizeof(uint16_t)) == cudaSuccess &&
+         cudaMemset(frame.celsius, 0, frame.size() * sizeof(float)) == cudaSuccess;
+}
+
+CudaRenderer::~CudaRenderer()
+{
+  if (stream_ != nullptr) {
+    cudaStreamDestroy(static_cast<cudaStream_t>(stream_));
+  }
+  cudaFreeHost(staging_);
+  cudaFree(mapping_);
+}
+
+bool CudaRenderer::check(int result, const std::string & what)
+{
+  if (result == cudaSuccess) {
+    return true;
+  }
+  error_ = what + ": " + cudaGetErrorString(static_cast<cudaError_t>(result));
+  return false;
+}
+
+bool CudaRenderer::open(std::size_t pixels)
+{
+  int devices = 0;
+  if (!check(cudaGetDeviceCount(&devices), "Looking for a CUDA device failed")) {
+    return false;
+  }
+  if (devices == 0) {
+    error_ = "No CUDA device";
+    return false;
+  }
+  cudaStream_t stream;
+  if (!check(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking), "Stream creation failed")) {
+    return false;
+  }
+  stream_ = stream;
+  pixels_ = pixels;
+  // The histogram mapping spans at most the whole uint16_t range
+  return check(cudaMallocHost(&staging_, pixels * sizeof(uint16_t)), "Pinned allocation failed") &&
+         check(cudaMalloc(&mapping_, UINT16_MAX + 1), "Device allocation failed");
+}
+
+std::shared_ptr<CudaFrame> CudaRenderer::free_frame(std::size_t width, std::size_t height)
+{
+  // A frame only the pool refers to is not read by any consumer anymore
+  for (std::shared_ptr<CudaFrame> & frame : frames_) {
+    if (frame.use_count() == 1) {
+      if (frame->width != width || frame->height != height) {
+        frame = std::make_shared<CudaFrame>();
+        if (!frame->allocate(width, height)) {
+          error_ = "Device allocation failed";
+          frame.reset();
+          frames_.erase(std::remove(frames_.begin(), frames_.end(), nullptr), frames_.end());
+          return nullptr;
+        }
+      }
+      return frame;
+    }
+  }
+  if (frames_.size() >= kCudaFramePool) {
+    error_ = "Consumers hold all " + std::to_string(kCudaFramePool) + " device frames";
+    return nullptr;
+  }
+  auto frame = std::make_shared<CudaFrame>();
+  if (!frame->allocate(width, height)) {
+    error_ = "Device allocation failed";
+    return nullptr;
+  }
+  frames_.push_back(frame);
+  return frame;
+}
+
+std::shared_ptr<const CudaFrame> CudaRenderer::render(
+  const RawFrame & raw, const CudaColormap & colormap)
+{
+  const std::size_t count = raw.size();
+  if (stream_ == nullptr || count > pixels_) {
+    error_ = "Frame does not fit the renderer";
+    return nullptr;
+  }
+  std::shared_ptr<CudaFrame> frame = free_frame(raw.width, raw.height);
+  if (!frame) {
+    return nullptr;
+  }
+  cudaStream_t stream = static_cast<cudaStream_t>(stream_);
+
+  // Only a changed palette or mapping is uploaded again
+  if (!has_palette_ || colormap.palette != palette_) {
+    const PaletteColors & colors = palette_colors(colormap.palette);
+    if (!check(
+        cudaMemcpyToSymbolAsync(
+          palette_device, colors.data(), colors.size(), 0, cudaMemcpyHostToDevice, stream),
+        "Palette upload failed"))
+    {
+      return nullptr;
+    }
+    palette_ = colormap.palette;
+    has_palette_ = true;
+  }
+  MappingArgs mapping = {nullptr, 0, 0};
+  if (colormap.mapping != nullptr && !colormap.mapping->empty()) {
+    const std::vector<uint8_t> & table = *colormap.mapping;
+    const std::size_t entries =
+      std::min<std::size_t>(table.size(), UINT16_MAX + 1 - colormap.first);
+    if (table != uploaded_mapping_) {
+      if (!check(
+          cudaMemcpyAsync(mapping_, table.data(), entries, cudaMemcpyHostToDevice, stream),
+          "Mapping upload failed"))
+      {
+        uploaded_mapping_.clear();
+        return nullptr;
+      }
+      uploaded_mapping_ = table;
+    }
+    mapping = {mapping_, colormap.first, static_cast<uint16_t>(colormap.first + entries - 1)};
+  }
+
+  memcpy(staging_, raw.pixels.data(), count * sizeof(uint16_t));
+  if (!check(
+      cudaMemcpyAsync(
+        frame->raw, staging_, count * sizeof(uint16_t), cudaMemcpyHostToDevice, stream),
+      "Frame upload failed"))
+  {
+    return nullptr;
+  }
+  const unsigned int blocks = static_cast<unsigned int>((count + kBlockSize - 1) / kBlockSize);
+  render_kernel<<<blocks, kBlockSize, 0, stream>>>(
+    frame->raw, count, colormap.min, colormap.max, colormap.scale, mapping, frame->rgb,
+    frame->celsius);
+  // Waiting here lets consumers use the frame on any stream, the kernel takes microseconds
+  if (!check(cudaGetLastError(), "Render kernel launch failed") ||
+    !check(cudaStreamSynchronize(stream), "Rendering failed"))
+  {
+    return nullptr;
+  }
+  return frame;
+}
+
+}  // namespace thermal_network
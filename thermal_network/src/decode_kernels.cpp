@@ -0,0 +1,75 @@
+/// \file Vectorized decode kernels
+/// \brief Runtime selection of the kernel set
+
+#include "thermal_network/decode_kernels.hpp"
+
+#include <atomic>
+
+namespace thermal_network
+{
+
+namespace
+{
+bool cpu_supports(const std::string & name)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (name == "sse4.1") {
+    return __builtin_cpu_supports("sse4.1");
+  }
+  if (name == "avx2") {
+    return __builtin_cpu_supports("avx2");
+  }
+#endif
+  // NEON is part of the aarch64 baseline, so it is available whenever it was built
+  return name == "scalar" || name == "neon";
+}
+
+std::atomic<const DecodeKernels *> active{nullptr};
+}  // namespace
+
+const DecodeKernels * find_decode_kernels(const std::string & name)
+{
+  if (name == "auto") {
+    for (const char * candidate : {"avx2", "sse4.1", "neon"}) {
+      if (const DecodeKernels * kernels = find_decode_kernels(candidate)) {
+        return kernels;
+      }
+    }
+    return scalar_kernels();
+  }
+
+  const DecodeKernels * kernels = nullptr;
+  if (name == "scalar") {
+    kernels = scalar_kernels();
+  } else if (name == "sse4.1") {
+    kernels = sse41_kernels();
+  } else if (name == "avx2") {
+    kernels = avx2_kernels();
+  } else if (name == "neon") {
+    kernels = neon_kernels();
+  }
+  return kernels != nullptr && cpu_supports(name) ? kernels : nullptr;
+}
+
+const DecodeKernels & active_decode_kernels()
+{
+  const DecodeKernels * kernels = active.load(std::memory_order_acquire);
+  if (kernels == nullptr) {
+    kernels = find_decode_kernels("auto");
+    active.store(kernels, std::memory_order_release);
+  }
+  return *kernels;
+}
+
+bool use_decode_kernels(const std::string & name)
+{
+  const DecodeKernels * kernels = find_decode_kernels(name);
+  if (kernels == nullptr) {
+    return false;
+  }
+  active.store(kernels, std::memory_order_release);
+  return true;
+}
+
+}  // namespace thermal_network
@@ -0,0 +1,163 @@
+/// \file Vectorized decode kernels
+/// \brief NEON kernels for aarch64 boards such as the Jetson and the Raspberry Pi
+
+#include "thermal_network/decode_kernels.hpp"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#include <algorithm>
+
+namespace thermal_network
+{
+
+namespace
+{
+// Same reasoning as the x86 kernels, multiplying by 0.01 rounds to the same float as dividing
+// by 100 for every uint16_t input
+constexpr double kCentikelvinToKelvin = 0.01;
+constexpr double kKelvinToCelsius = 273.0;
+
+template<std::size_t G>
+struct NeonDecoder
+{
+  static void decode(const Frame & frame, RawFrame & raw)
+  {
+    constexpr SensorGeometry geometry = kSensorGeometries[G];
+    const uint16x8_t zero = vdupq_n_u16(0);
+    uint16x8_t vmin = vdupq_n_u16(UINT16_MAX);
+    uint16x8_t vmax = zero;
+    uint16x8_t zeros = zero;
+    const uint8_t * packet = frame.data.data() + geometry.video_offset();
+    uint16_t * out = raw.pixels.data();
+    for (std::size_t p = 0; p < geometry.video_packets(); ++p) {
+      const uint8_t * in = packet + kPacketHeaderWords * 2;
+      for (std::size_t w = 0; w < kPacketPixels; w += 8) {
+        uint16x8_t v = vreinterpretq_u16_u8(vrev16q_u8(vld1q_u8(in + w * 2)));
+        vst1q_u16(out + w, v);
+        // Zero lanes count themselves and are lifted to 0xFFFF so they never win the minimum
+        uint16x8_t is_zero = vceqq_u16(v, zero);
+        zeros = vsubq_u16(zeros, is_zero);
+        vmin = vminq_u16(vmin, vorrq_u16(v, is_zero));
+        vmax = vmaxq_u16(vmax, v);
+      }
+      packet += kPacketBytes;
+      out += kPacketPixels;
+    }
+    const std::size_t zero_pixels = vaddlvq_u16(zeros);
+    raw.width = geometry.width;
+    raw.height = geometry.height;
+    raw.min = zero_pixels == geometry.pixels() ? 0 : vminvq_u16(vmin);
+    raw.max = vmaxvq_u16(vmax);
+    raw.zero_pixels = zero_pixels;
+  }
+};
+
+void normalize_neon(
+  const uint16_t * raw, std::size_t count, uint16_t min, uint16_t max, float scale,
+  uint8_t * index)
+{
+  const uint16x8_t vmin = vdupq_n_u16(min);
+  const uint16x8_t vmax = vdupq_n_u16(max);
+  const int32x4_t min32 = vdupq_n_s32(min);
+  const float32x4_t vscale = vdupq_n_f32(scale);
+  const float32x4_t top = vdupq_n_f32(255.0f);
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t v = vld1q_u16(raw + i);
+    int32x4_t lo = vsubq_s32(vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v))), min32);
+    int32x4_t hi = vsubq_s32(vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(v))), min32);
+    float32x4_t flo = vminq_f32(vmulq_f32(vcvtq_f32_s32(lo), vscale), top);
+    float32x4_t fhi = vminq_f32(vmulq_f32(vcvtq_f32_s32(hi), vscale), top);
+    // Values below the range go negative and saturate to 0 when narrowed
+    uint16x8_t idx = vcombine_u16(
+      vqmovun_s32(vcvtq_s32_f32(flo)), vqmovun_s32(vcvtq_s32_f32(fhi)));
+    idx = vorrq_u16(idx, vandq_u16(vcgeq_u16(v, vmax), vdupq_n_u16(255)));
+    idx = vbicq_u16(idx, vcleq_u16(v, vmin));
+    vst1_u8(index + i, vmovn_u16(idx));
+  }
+  for (; i < count; ++i) {
+    uint16_t value = raw[i];
+    if (value <= min) {
+      index[i] = 0;
+    } else if (value >= max) {
+      index[i] = 255;
+    } else {
+      index[i] = static_cast<uint8_t>(std::min((value - min) * scale, 255.0f));
+    }
+  }
+}
+
+void to_celsius_neon(const uint16_t * raw, std::size_t count, float * celsius)
+{
+  const float64x2_t factor = vdupq_n_f64(kCentikelvinToKelvin);
+  const float64x2_t offset = vdupq_n_f64(kKelvinToCelsius);
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t v = vld1q_u16(raw + i);
+    uint32x4_t halves[2] = {vmovl_u16(vget_low_u16(v)), vmovl_u16(vget_high_u16(v))};
+    for (int h = 0; h < 2; ++h) {
+      float64x2_t a = vcvtq_f64_u64(vmovl_u32(vget_low_u32(halves[h])));
+      float64x2_t b = vcvtq_f64_u64(vmovl_u32(vget_high_u32(halves[h])));
+      a = vsubq_f64(vmulq_f64(a, factor), offset);
+      b = vsubq_f64(vmulq_f64(b, factor), offset);
+      vst1q_f32(celsius + i + h * 4, vcvt_high_f32_f64(vcvt_f32_f64(a), b));
+    }
+  }
+  for (; i < count; ++i) {
+    celsius[i] = static_cast<float>((raw[i] / 100.0) - 273.0);
+  }
+}
+
+void calibrate_neon(uint16_t * raw, std::size_t count, const float * gain, const float * offset)
+{
+  const float32x4_t low = vdupq_n_f32(0.0f);
+  const float32x4_t high = vdupq_n_f32(65535.0f);
+  const float32x4_t half = vdupq_n_f32(0.5f);
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t v = vld1q_u16(raw + i);
+    uint32x4_t halves[2] = {vmovl_u16(vget_low_u16(v)), vmovl_u16(vget_high_u16(v))};
+    uint16x4_t out[2];
+    for (int h = 0; h < 2; ++h) {
+      // A separate multiply and add, a fused one would round differently than the scalar code
+      float32x4_t value = vaddq_f32(
+        vmulq_f32(vcvtq_f32_u32(halves[h]), vld1q_f32(gain + i + h * 4)),
+        vld1q_f32(offset + i + h * 4));
+      value = vaddq_f32(vminq_f32(vmaxq_f32(value, low), high), half);
+      out[h] = vmovn_u32(vcvtq_u32_f32(value));
+    }
+    vst1q_u16(raw + i, vcombine_u16(out[0], out[1]));
+  }
+  for (; i < count; ++i) {
+    const float value = raw[i] * gain[i] + offset[i];
+    raw[i] = static_cast<uint16_t>(std::min(std::max(value, 0.0f), 65535.0f) + 0.5f);
+  }
+}
+
+const DecodeKernels kNeonKernels = {
+  "neon", make_decode_frame_table<NeonDecoder>(), normalize_neon, to_celsius_neon,
+  calibrate_neon};
+}  // namespace
+
+const DecodeKernels * neon_kernels()
+{
+  return &kNeonKernels;
+}
+
+}  // namespace thermal_network
+
+#else
+
+namespace thermal_network
+{
+
+const DecodeKernels * neon_kernels()
+{
+  return nullptr;
+}
+
+}  // namespace thermal_network
+
+#endif
@@ -0,0 +1,348 @@
+/// \file Vectorized decode kernels
+/// \brief SSE4.1 and AVX2 kernels, compiled with target attributes and picked at runtime
+
+#include "thermal_network/decode_kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+#include <algorithm>
+
+namespace thermal_network
+{
+
+namespace
+{
+// The Celsius conversion multiplies by 0.01 instead of dividing by 100. Both round to the same
+// float for every uint16_t input, which keeps the kernels bit-exact with the scalar reference.
+constexpr double kCentikelvinToKelvin = 0.01;
+constexpr double kKelvinToCelsius = 273.0;
+
+void normalize_tail(
+  const uint16_t * raw, std::size_t count, uint16_t min, uint16_t max, float scale,
+  uint8_t * index)
+{
+  for (std::size_t i = 0; i < count; ++i) {
+    uint16_t value = raw[i];
+    if (value <= min) {
+      index[i] = 0;
+    } else if (value >= max) {
+      index[i] = 255;
+    } else {
+      index[i] = static_cast<uint8_t>(std::min((value - min) * scale, 255.0f));
+    }
+  }
+}
+
+void to_celsius_tail(const uint16_t * raw, std::size_t count, float * celsius)
+{
+  for (std::size_t i = 0; i < count; ++i) {
+    celsius[i] = static_cast<float>((raw[i] / 100.0) - 273.0);
+  }
+}
+
+void calibrate_tail(uint16_t * raw, std::size_t count, const float * gain, const float * offset)
+{
+  for (std::size_t i = 0; i < count; ++i) {
+    const float value = raw[i] * gain[i] + offset[i];
+    raw[i] = static_cast<uint16_t>(std::min(std::max(value, 0.0f), 65535.0f) + 0.5f);
+  }
+}
+
+// SSE4.1
+
+template<std::size_t G>
+struct Sse41Decoder
+{
+  __attribute__((target("sse4.1")))
+  static void decode(const Frame & frame, RawFrame & raw)
+  {
+    constexpr SensorGeometry geometry = kSensorGeometries[G];
+    const __m128i zero = _mm_setzero_si128();
+    __m128i vmin = _mm_set1_epi16(-1);
+    __m128i vmax = zero;
+    __m128i zeros = zero;
+    const uint8_t * packet = frame.data.data() + geometry.video_offset();
+    uint16_t * out = raw.pixels.data();
+    for (std::size_t p = 0; p < geometry.video_packets(); ++p) {
+      const uint8_t * in = packet + kPacketHeaderWords * 2;
+      for (std::size_t w = 0; w < kPacketPixels; w += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + w * 2));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + w), v);
+        // Zero lanes count themselves and are lifted to 0xFFFF so they never win the minimum
+        __m128i is_zero = _mm_cmpeq_epi16(v, zero);
+        zeros = _mm_sub_epi16(zeros, is_zero);
+        vmin = _mm_min_epu16(vmin, _mm_or_si128(v, is_zero));
+        vmax = _mm_max_epu16(vmax, v);
+      }
+      packet += kPacketBytes;
+      out += kPacketPixels;
+    }
+    __m128i sums = _mm_madd_epi16(zeros, _mm_set1_epi16(1));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(2, 3, 0, 1)));
+    const std::size_t zero_pixels = static_cast<uint32_t>(_mm_cvtsi128_si32(sums));
+    const uint16_t min = static_cast<uint16_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(vmin)));
+    const uint16_t max = static_cast<uint16_t>(
+      ~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(vmax, _mm_set1_epi16(-1)))));
+    raw.width = geometry.width;
+    raw.height = geometry.height;
+    raw.min = zero_pixels == geometry.pixels() ? 0 : min;
+    raw.max = max;
+    raw.zero_pixels = zero_pixels;
+  }
+};
+
+/// \brief Normalizes 8 values to 32 bit indices in two vectors
+__attribute__((target("sse4.1")))
+inline __m128i normalize8_sse41(__m128i v, __m128i vmin, __m128i vmax, __m128 scale)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 top = _mm_set1_ps(255.0f);
+  const __m128i min32 = _mm_unpacklo_epi16(vmin, zero);
+  __m128 lo = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_unpacklo_epi16(v, zero), min32));
+  __m128 hi = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_unpackhi_epi16(v, zero), min32));
+  lo = _mm_min_ps(_mm_mul_ps(lo, scale), top);
+  hi = _mm_min_ps(_mm_mul_ps(hi, scale), top);
+  // Values below the range go negative and saturate to 0 when packed
+  __m128i index = _mm_packus_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi));
+  __m128i at_max = _mm_cmpeq_epi16(_mm_min_epu16(v, vmax), vmax);
+  __m128i at_min = _mm_cmpeq_epi16(_mm_max_epu16(v, vmin), vmin);
+  index = _mm_or_si128(index, _mm_and_si128(at_max, _mm_set1_epi16(255)));
+  return _mm_andnot_si128(at_min, index);
+}
+
+__attribute__((target("sse4.1")))
+void normalize_sse41(
+  const uint16_t * raw, std::size_t count, uint16_t min, uint16_t max, float scale,
+  uint8_t * index)
+{
+  const __m128i vmin = _mm_set1_epi16(static_cast<int16_t>(min));
+  const __m128i vmax = _mm_set1_epi16(static_cast<int16_t>(max));
+  const __m128 vscale = _mm_set1_ps(scale);
+  std::size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i + 8));
+    __m128i packed = _mm_packus_epi16(
+      normalize8_sse41(a, vmin, vmax, vscale), normalize8_sse41(b, vmin, vmax, vscale));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(index + i), packed);
+  }
+  normalize_tail(raw + i, count - i, min, max, scale, index + i);
+}
+
+__attribute__((target("sse4.1")))
+void to_celsius_sse41(const uint16_t * raw, std::size_t count, float * celsius)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128d factor = _mm_set1_pd(kCentikelvinToKelvin);
+  const __m128d offset = _mm_set1_pd(kKelvinToCelsius);
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i));
+    __m128i halves[2] = {_mm_unpacklo_epi16(v, zero), _mm_unpackhi_epi16(v, zero)};
+    for (int h = 0; h < 2; ++h) {
+      __m128d a = _mm_cvtepi32_pd(halves[h]);
+      __m128d b = _mm_cvtepi32_pd(_mm_unpackhi_epi64(halves[h], halves[h]));
+      a = _mm_sub_pd(_mm_mul_pd(a, factor), offset);
+      b = _mm_sub_pd(_mm_mul_pd(b, factor), offset);
+      _mm_storeu_ps(celsius + i + h * 4, _mm_movelh_ps(_mm_cvtpd_ps(a), _mm_cvtpd_ps(b)));
+    }
+  }
+  to_celsius_tail(raw + i, count - i, celsius + i);
+}
+
+__attribute__((target("sse4.1")))
+void calibrate_sse41(uint16_t * raw, std::size_t count, const float * gain, const float * offset)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 low = _mm_setzero_ps();
+  const __m128 high = _mm_set1_ps(65535.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i));
+    __m128 halves[2] = {
+      _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero))};
+    __m128i out[2];
+    for (int h = 0; h < 2; ++h) {
+      __m128 value = _mm_add_ps(
+        _mm_mul_ps(halves[h], _mm_loadu_ps(gain + i + h * 4)), _mm_loadu_ps(offset + i + h * 4));
+      value = _mm_add_ps(_mm_min_ps(_mm_max_ps(value, low), high), half);
+      out[h] = _mm_cvttps_epi32(value);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(raw + i), _mm_packus_epi32(out[0], out[1]));
+  }
+  calibrate_tail(raw + i, count - i, gain + i, offset + i);
+}
+
+// AVX2
+
+template<std::size_t G>
+struct Avx2Decoder
+{
+  static_assert(kPacketPixels % 16 == 0, "AVX2 decode works on 16 pixels at a time");
+
+  __attribute__((target("avx2")))
+  static void decode(const Frame & frame, RawFrame & raw)
+  {
+    constexpr SensorGeometry geometry = kSensorGeometries[G];
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i vmin = _mm256_set1_epi16(-1);
+    __m256i vmax = zero;
+    __m256i zeros = zero;
+    const uint8_t * packet = frame.data.data() + geometry.video_offset();
+    uint16_t * out = raw.pixels.data();
+    for (std::size_t p = 0; p < geometry.video_packets(); ++p) {
+      const uint8_t * in = packet + kPacketHeaderWords * 2;
+      for (std::size_t w = 0; w < kPacketPixels; w += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + w * 2));
+        v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + w), v);
+        __m256i is_zero = _mm256_cmpeq_epi16(v, zero);
+        zeros = _mm256_sub_epi16(zeros, is_zero);
+        vmin = _mm256_min_epu16(vmin, _mm256_or_si256(v, is_zero));
+        vmax = _mm256_max_epu16(vmax, v);
+      }
+      packet += kPacketBytes;
+      out += kPacketPixels;
+    }
+    __m128i min128 = _mm_min_epu16(
+      _mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1));
+    __m128i max128 = _mm_max_epu16(
+      _mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1));
+    __m256i sums256 = _mm256_madd_epi16(zeros, _mm256_set1_epi16(1));
+    __m128i sums = _mm_add_epi32(
+      _mm256_castsi256_si128(sums256), _mm256_extracti128_si256(sums256, 1));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(2, 3, 0, 1)));
+    const std::size_t zero_pixels = static_cast<uint32_t>(_mm_cvtsi128_si32(sums));
+    const uint16_t min = static_cast<uint16_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(min128)));
+    const uint16_t max = static_cast<uint16_t>(
+      ~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(max128, _mm_set1_epi16(-1)))));
+    raw.width = geometry.width;
+    raw.height = geometry.height;
+    raw.min = zero_pixels == geometry.pixels() ? 0 : min;
+    raw.max = max;
+    raw.zero_pixels = zero_pixels;
+  }
+};
+
+__attribute__((target("avx2")))
+void normalize_avx2(
+  const uint16_t * raw, std::size_t count, uint16_t min, uint16_t max, float scale,
+  uint8_t * index)
+{
+  const __m256i vmin = _mm256_set1_epi16(static_cast<int16_t>(min));
+  const __m256i vmax = _mm256_set1_epi16(static_cast<int16_t>(max));
+  const __m256i min32 = _mm256_set1_epi32(min);
+  const __m256 vscale = _mm256_set1_ps(scale);
+  const __m256 top = _mm256_set1_ps(255.0f);
+  std::size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i lo16 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i));
+    __m128i hi16 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i + 8));
+    __m256i v = _mm256_set_m128i(hi16, lo16);
+    __m256 lo = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_cvtepu16_epi32(lo16), min32));
+    __m256 hi = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_cvtepu16_epi32(hi16), min32));
+    lo = _mm256_min_ps(_mm256_mul_ps(lo, vscale), top);
+    hi = _mm256_min_ps(_mm256_mul_ps(hi, vscale), top);
+    // packus works per 128 bit lane, the permute puts the 16 indices back in order
+    __m256i idx = _mm256_permute4x64_epi64(
+      _mm256_packus_epi32(_mm256_cvttps_epi32(lo), _mm256_cvttps_epi32(hi)),
+      _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i at_max = _mm256_cmpeq_epi16(_mm256_min_epu16(v, vmax), vmax);
+    __m256i at_min = _mm256_cmpeq_epi16(_mm256_max_epu16(v, vmin), vmin);
+    idx = _mm256_or_si256(idx, _mm256_and_si256(at_max, _mm256_set1_epi16(255)));
+    idx = _mm256_andnot_si256(at_min, idx);
+    __m128i packed = _mm_packus_epi16(
+      _mm256_castsi256_si128(idx), _mm256_extracti128_si256(idx, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(index + i), packed);
+  }
+  normalize_tail(raw + i, count - i, min, max, scale, index + i);
+}
+
+__attribute__((target("avx2")))
+void to_celsius_avx2(const uint16_t * raw, std::size_t count, float * celsius)
+{
+  const __m256d factor = _mm256_set1_pd(kCentikelvinToKelvin);
+  const __m256d offset = _mm256_set1_pd(kKelvinToCelsius);
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i v = _mm256_cvtepu16_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i)));
+    __m256d a = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+    __m256d b = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+    a = _mm256_sub_pd(_mm256_mul_pd(a, factor), offset);
+    b = _mm256_sub_pd(_mm256_mul_pd(b, factor), offset);
+    _mm256_storeu_ps(celsius + i, _mm256_set_m128(_mm256_cvtpd_ps(b), _mm256_cvtpd_ps(a)));
+  }
+  to_celsius_tail(raw + i, count - i, celsius + i);
+}
+
+__attribute__((target("avx2")))
+void calibrate_avx2(uint16_t * raw, std::size_t count, const float * gain, const float * offset)
+{
+  const __m256 low = _mm256_setzero_ps();
+  const __m256 high = _mm256_set1_ps(65535.0f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  std::size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i out[2];
+    for (int h = 0; h < 2; ++h) {
+      __m256 value = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i + h * 8))));
+      value = _mm256_add_ps(
+        _mm256_mul_ps(value, _mm256_loadu_ps(gain + i + h * 8)),
+        _mm256_loadu_ps(offset + i + h * 8));
+      value = _mm256_add_ps(_mm256_min_ps(_mm256_max_ps(value, low), high), half);
+      out[h] = _mm256_cvttps_epi32(value);
+    }
+    // packus works per 128 bit lane, the permute puts the 16 values back in order
+    __m256i packed = _mm256_permute4x64_epi64(
+      _mm256_packus_epi32(out[0], out[1]), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(raw + i), packed);
+  }
+  calibrate_tail(raw + i, count - i, gain + i, offset + i);
+}
+
+const DecodeKernels kSse41Kernels = {
+  "sse4.1", make_decode_frame_table<Sse41Decoder>(), normalize_sse41, to_celsius_sse41,
+  calibrate_sse41};
+const DecodeKernels kAvx2Kernels = {
+  "avx2", make_decode_frame_table<Avx2Decoder>(), normalize_avx2, to_celsius_avx2,
+  calibrate_avx2};
+}  // namespace
+
+const DecodeKernels * sse41_kernels()
+{
+  return &kSse41Kernels;
+}
+
+const DecodeKernels * avx2_kernels()
+{
+  return &kAvx2Kernels;
+}
+
+}  // namespace thermal_network
+
+#else
+
+namespace thermal_network
+{
+
+const DecodeKernels * sse41_kernels()
+{
+  return nullptr;
+}
+
+const DecodeKernels * avx2_kernels()
+{
+  return nullptr;
+}
+
+}  // namespace thermal_network
+
+#endif
@@ -0,0 +1,98 @@
+/// \file Lepton frame reassembly
+/// \brief Implementation of FrameAssembler
+
+#include "thermal_network/frame_assembler.hpp"
+
+#include <cstring>
+
+namespace thermal_network
+{
+
+namespace
+{
+/// \brief Packet of a segment whose ID word carries the segment number
+constexpr std::size_t kSegmentNumberPacket = 20;
+}  // namespace
+
+int segment_number(const uint8_t * segment, const SensorGeometry & geometry)
+{
+  const uint8_t * id = segment + kSegmentNumberPacket * kPacketBytes;
+  // ID word is xTTT PPPP PPPP PPPP, discard packets have xFxx
+  if ((id[0] & 0x0F) == 0x0F) {
+    return 0;
+  }
+  unsigned int packet = ((id[0] & 0x0F) << 8) | id[1];
+  if (packet != kSegmentNumberPacket) {
+    return 0;
+  }
+  if (geometry.segments == 1) {
+    return 1;
+  }
+  int number = (id[0] >> 4) & 0x07;
+  if (number < 1 || number > static_cast<int>(geometry.segments)) {
+    return 0;
+  }
+  return number;
+}
+
+FrameAssembler::FrameAssembler(int64_t timeout_ns, std::size_t geometry)
+: timeout_ns_(timeout_ns),
+  geometry_(geometry < kSensorGeometryCount ? geometry : kDefaultSensorGeometry),
+  all_segments_((1u << kSensorGeometries[geometry_].segments) - 1)
+{
+}
+
+bool FrameAssembler::add(
+  const uint8_t * data, std::size_t size, int64_t stamp_ns, int64_t now_ns,
+  Frame & frame)
+{
+  const SensorGeometry & geometry = kSensorGeometries[geometry_];
+  int number = size == geometry.segment_bytes() ? segment_number(data, geometry) : 0;
+  if (number == 0) {
+    invalid_segments_++;
+    return false;
+  }
+
+  if (present_ != 0 && now_ns - started_ns_ > timeout_ns_) {
+    drop_incomplete();
+  }
+
+  unsigned int bit = 1u << (number - 1);
+  if (number == 1) {
+    if (present_ != 0) {
+      drop_incomplete();
+    }
+    started_ns_ = now_ns;
+    frame.geometry = geometry_;
+    frame.stamp_ns = stamp_ns;
+  } else if (present_ == 0) {
+    orphan_segments_++;
+    return false;
+  } else if (present_ & bit) {
+    drop_incomplete();
+    orphan_segments_++;
+    return false;
+  }
+
+  memcpy(&frame.data[(number - 1) * geometry.segment_bytes()], data, geometry.segment_bytes());
+  present_ |= bit;
+  if (present_ != all_segments_) {
+    return false;
+  }
+  present_ = 0;
+  complete_frames_++;
+  return true;
+}
+
+void FrameAssembler::reset()
+{
+  present_ = 0;
+}
+
+void FrameAssembler::drop_incomplete()
+{
+  incomplete_frames_++;
+  present_ = 0;
+}
+
+}  // namespace thermal_network
@@ -0,0 +1,235 @@
+/// \file Lepton frame decoding
+/// \brief Scalar implementation of the decode passes and dispatch to the active kernels
+
+#include "thermal_network/frame_decoder.hpp"
+
+#include <algorithm>
+
+#include "thermal_network/decode_kernels.hpp"
+
+namespace thermal_network
+{
+
+namespace
+{
+template<std::size_t G>
+struct ScalarDecoder
+{
+  static void decode(const Frame & frame, RawFrame & raw)
+  {
+    // Put back to back the segments hold the video packets in row order, two packets make one
+    // row of a Lepton 3.x and one row of a Lepton 2.x
+    constexpr SensorGeometry geometry = kSensorGeometries[G];
+    uint16_t min = UINT16_MAX;
+    uint16_t max = 0;
+    std::size_t zero_pixels = 0;
+    const uint8_t * packet = frame.data.data() + geometry.video_offset();
+    uint16_t * out = raw.pixels.data();
+    for (std::size_t p = 0; p < geometry.video_packets(); ++p) {
+      const uint8_t * in = packet + kPacketHeaderWords * 2;
+      for (std::size_t w = 0; w < kPacketPixels; ++w) {
+        uint16_t value = static_cast<uint16_t>((in[w * 2] << 8) | in[w * 2 + 1]);
+        out[w] = value;
+        if (value == 0) {
+          zero_pixels++;
+        } else {
+          min = std::min(min, value);
+        }
+        max = std::max(max, value);
+      }
+      packet += kPacketBytes;
+      out += kPacketPixels;
+    }
+    raw.width = geometry.width;
+    raw.height = geometry.height;
+    raw.min = zero_pixels == geometry.pixels() ? 0 : min;
+    raw.max = max;
+    raw.zero_pixels = zero_pixels;
+  }
+};
+
+void normalize_scalar(
+  const uint16_t * raw, std::size_t count, uint16_t min, uint16_t max, float scale,
+  uint8_t * index)
+{
+  for (std::size_t i = 0; i < count; ++i) {
+    uint16_t value = raw[i];
+    if (value <= min) {
+      index[i] = 0;
+    } else if (value >= max) {
+      index[i] = 255;
+    } else {
+      index[i] = static_cast<uint8_t>(std::min((value - min) * scale, 255.0f));
+    }
+  }
+}
+
+void to_celsius_scalar(const uint16_t * raw, std::size_t count, float * celsius)
+{
+  for (std::size_t i = 0; i < count; ++i) {
+    celsius[i] = static_cast<float>((raw[i] / 100.0) - 273.0);
+  }
+}
+
+void calibrate_scalar(uint16_t * raw, std::size_t count, const float * gain, const float * offset)
+{
+  for (std::size_t i = 0; i < count; ++i) {
+    const float value = raw[i] * gain[i] + offset[i];
+    raw[i] = static_cast<uint16_t>(std::min(std::max(value, 0.0f), 65535.0f) + 0.5f);
+  }
+}
+
+const DecodeKernels kScalarKernels = {
+  "scalar", make_decode_frame_table<ScalarDecoder>(), normalize_scalar, to_celsius_scalar,
+  calibrate_scalar};
+
+template<PoolMode Mode>
+void pool_rows(const RawFrame & raw, std::size_t factor, RawFrame & out)
+{
+  // Each output row accumulates factor input rows column by column, so every input row is read
+  // once and in order
+  std::array<uint32_t, kFrameWidth> blocks;
+  const uint32_t area = static_cast<uint32_t>(factor * factor);
+  for (std::size_t y = 0; y < out.height; ++y) {
+    std::fill(blocks.begin(), blocks.begin() + out.width, 0);
+    for (std::size_t r = 0; r < factor; ++r) {
+      const uint16_t * row = raw.pixels.data() + (y * factor + r) * raw.width;
+      for (std::size_t x = 0; x < out.width; ++x) {
+        const uint16_t * block = row + x * factor;
+        for (std::size_t c = 0; c < factor; ++c) {
+          if (Mode == PoolMode::kMean) {
+            blocks[x] += block[c];
+          } else {
+            blocks[x] = std::max<uint32_t>(blocks[x], block[c]);
+          }
+        }
+      }
+    }
+    uint16_t * pixels = out.pixels.data() + y * out.width;
+    for (std::size_t x = 0; x < out.width; ++x) {
+      pixels[x] = static_cast<uint16_t>(
+        Mode == PoolMode::kMean ? (blocks[x] + area / 2) / area : blocks[x]);
+    }
+  }
+}
+}  // namespace
+
+void update_range(RawFrame & raw)
+{
+  uint16_t min = UINT16_MAX;
+  uint16_t max = 0;
+  std::size_t zero_pixels = 0;
+  for (std::size_t i = 0; i < raw.size(); ++i) {
+    const uint16_t value = raw.pixels[i];
+    zero_pixels += value == 0;
+    min = std::min<uint16_t>(min, value == 0 ? UINT16_MAX : value);
+    max = std::max(max, value);
+  }
+  raw.min = zero_pixels == raw.size() ? 0 : min;
+  raw.max = max;
+  raw.zero_pixels = zero_pixels;
+}
+
+bool parse_pool_mode(const std::string & name, PoolMode & mode)
+{
+  if (name == "mean") {
+    mode = PoolMode::kMean;
+  } else if (name == "max") {
+    mode = PoolMode::kMax;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const DecodeKernels * scalar_kernels()
+{
+  return &kScalarKernels;
+}
+
+void decode_frame(const Frame & frame, RawFrame & raw)
+{
+  active_decode_kernels().decode_frame[frame.geometry](frame, raw);
+}
+
+void normalize(
+  const uint16_t * raw, std::size_t count, uint16_t min, uint16_t max, float scale,
+  uint8_t * index)
+{
+  active_decode_kernels().normalize(raw, count, min, max, scale, index);
+}
+
+void to_celsius(const uint16_t * raw, std::size_t count, float * celsius)
+{
+  active_decode_kernels().to_celsius(raw, count, celsius);
+}
+
+void calibrate(uint16_t * raw, std::size_t count, const float * gain, const float * offset)
+{
+  active_decode_kernels().calibrate(raw, count, gain, offset);
+}
+
+RegionStats region_stats(const RawFrame & raw, const Region & region)
+{
+  RegionStats stats;
+  const std::size_t x_end = std::min(region.x + region.width, raw.width);
+  const std::size_t y_end = std::min(region.y + region.height, raw.height);
+  if (region.x >= x_end || region.y >= y_end) {
+    return stats;
+  }
+
+  uint16_t min = UINT16_MAX;
+  uint16_t max = 0;
+  uint64_t sum = 0;
+  std::size_t hottest = region.y * raw.width + region.x;
+  for (std::size_t y = region.y; y < y_end; ++y) {
+    const uint16_t * row = raw.pixels.data() + y * raw.width;
+    for (std::size_t x = region.x; x < x_end; ++x) {
+      uint16_t value = row[x];
+      sum += value;
+      min = std::min(min, value);
+      if (value > max) {
+        max = value;
+        hottest = y * raw.width + x;
+      }
+    }
+  }
+  stats.min = min;
+  stats.max = max;
+  stats.mean = static_cast<double>(sum) / ((x_end - region.x) * (y_end - region.y));
+  stats.hottest_x = hottest % raw.width;
+  stats.hottest_y = hottest / raw.width;
+  return stats;
+}
+
+void crop(const RawFrame & raw, const Region & region, RawFrame & out)
+{
+  const std::size_t x = std::min(region.x, raw.width);
+  const std::size_t y = std::min(region.y, raw.height);
+  out.width = std::min(region.width, raw.width - x);
+  out.height = std::min(region.height, raw.height - y);
+  if (out.width == 0 || out.height == 0) {
+    out.width = 0;
+    out.height = 0;
+  }
+  for (std::size_t row = 0; row < out.height; ++row) {
+    const uint16_t * in = raw.pixels.data() + (y + row) * raw.width + x;
+    std::copy(in, in + out.width, out.pixels.data() + row * out.width);
+  }
+  update_range(out);
+}
+
+void pool(const RawFrame & raw, std::size_t factor, PoolMode mode, RawFrame & out)
+{
+  factor = std::max<std::size_t>(factor, 1);
+  out.width = raw.width / factor;
+  out.height = raw.height / factor;
+  if (mode == PoolMode::kMean) {
+    pool_rows<PoolMode::kMean>(raw, factor, out);
+  } else {
+    pool_rows<PoolMode::kMax>(raw, factor, out);
+  }
+  update_range(out);
+}
+
+}  // namespace thermal_network
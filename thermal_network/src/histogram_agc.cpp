@@ -0,0 +1,62 @@
+/// \file Histogram equalized automatic gain control
+/// \brief Implementation of HistogramAgc
+
+#include "thermal_network/histogram_agc.hpp"
+
+#include <algorithm>
+
+namespace thermal_network
+{
+
+HistogramAgc::HistogramAgc(double clip_percent)
+: clip_share_(std::clamp(clip_percent, 0.0, 49.0) / 100.0),
+  histogram_(UINT16_MAX + 1, 0),
+  previous_(kFramePixels, 0)
+{
+}
+
+void HistogramAgc::equalize(const RawFrame & raw, uint16_t & first, std::vector<uint8_t> & index)
+{
+  uint32_t * histogram = histogram_.data();
+  const uint16_t * pixels = raw.pixels.data();
+  uint16_t * previous = previous_.data();
+  const std::size_t count = raw.size();
+  if (!primed_) {
+    histogram_[0] = count;
+    primed_ = true;
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    if (pixels[i] != previous[i]) {
+      histogram[previous[i]]--;
+      histogram[pixels[i]]++;
+      previous[i] = pixels[i];
+    }
+  }
+
+  // Clip the given share of the pixels off both ends, the remaining values are spread over the
+  // palette by their cumulative count
+  const std::size_t clip_pixels = static_cast<std::size_t>(clip_share_ * count);
+  uint32_t below = 0;
+  uint16_t low = raw.min;
+  while (low < raw.max && below + histogram[low] <= clip_pixels) {
+    below += histogram[low++];
+  }
+  uint32_t above = 0;
+  uint16_t high = raw.max;
+  while (high > low && above + histogram[high] <= clip_pixels) {
+    above += histogram[high--];
+  }
+
+  first = low;
+  index.resize(high - low + 1);
+  const uint32_t base = histogram[low];
+  const uint32_t span = count - below - above - base;
+  uint32_t cumulative = 0;
+  for (std::size_t v = low; v <= high; ++v) {
+    cumulative += histogram[v];
+    index[v - low] = span == 0 ? 0 :
+      static_cast<uint8_t>((static_cast<uint64_t>(cumulative - base) * 255 + span / 2) / span);
+  }
+}
+
+}  // namespace thermal_network
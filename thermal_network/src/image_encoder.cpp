@@ -0,0 +1,247 @@
+/// \file Image compression
+/// \brief PNG through zlib, QOI implemented here and JPEG through libjpeg
+
+#include "thermal_network/image_encoder.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef THERMAL_NETWORK_HAS_JPEG
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+#endif
+
+namespace thermal_network
+{
+
+namespace
+{
+void put_u32(std::vector<uint8_t> & out, uint32_t value)
+{
+  out.push_back(value >> 24);
+  out.push_back((value >> 16) & 0xFF);
+  out.push_back((value >> 8) & 0xFF);
+  out.push_back(value & 0xFF);
+}
+
+void put_png_chunk(
+  std::vector<uint8_t> & out, const char * type, const uint8_t * data, std::size_t size)
+{
+  put_u32(out, size);
+  const std::size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data, data + size);
+  put_u32(out, crc32(0, out.data() + start, size + 4));
+}
+
+bool encode_png(
+  const uint8_t * index, std::size_t width, std::size_t height, const PaletteColors & colors,
+  int level, std::vector<uint8_t> & out)
+{
+  // Every row starts with its filter type, 0 for none, which suits indexed images best
+  std::vector<uint8_t> rows(height * (width + 1));
+  for (std::size_t y = 0; y < height; ++y) {
+    rows[y * (width + 1)] = 0;
+    memcpy(&rows[y * (width + 1) + 1], index + y * width, width);
+  }
+  uLongf packed_size = compressBound(rows.size());
+  std::vector<uint8_t> packed(packed_size);
+  if (compress2(packed.data(), &packed_size, rows.data(), rows.size(), std::clamp(level, 1, 9)) !=
+    Z_OK)
+  {
+    return false;
+  }
+
+  static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  out.clear();
+  out.insert(out.end(), kSignature, kSignature + 8);
+  std::vector<uint8_t> header;
+  put_u32(header, width);
+  put_u32(header, height);
+  header.insert(header.end(), {8, 3, 0, 0, 0});  // 8 bit, indexed, deflate, no interlace
+  put_png_chunk(out, "IHDR", header.data(), header.size());
+  put_png_chunk(out, "PLTE", colors.data(), colors.size());
+  put_png_chunk(out, "IDAT", packed.data(), packed_size);
+  put_png_chunk(out, "IEND", nullptr, 0);
+  return true;
+}
+
+void encode_qoi(
+  const uint8_t * index, std::size_t width, std::size_t height, const PaletteColors & colors,
+  std::vector<uint8_t> & out)
+{
+  // Straight from the QOI specification, the alpha channel is always opaque
+  out.clear();
+  out.insert(out.end(), {'q', 'o', 'i', 'f'});
+  put_u32(out, width);
+  put_u32(out, height);
+  out.push_back(3);  // RGB
+  out.push_back(0);  // sRGB with linear alpha
+
+  // RGBA as in the specification, unused entries are all zeros and never match an opaque pixel
+  uint8_t seen[64][4] = {};
+  uint8_t previous[3] = {0, 0, 0};
+  int run = 0;
+  const std::size_t count = width * height;
+  for (std::size_t i = 0; i < count; ++i) {
+    const uint8_t * pixel = &colors[index[i] * 3];
+    if (memcmp(pixel, previous, 3) == 0) {
+      if (++run == 62 || i + 1 == count) {
+        out.push_back(0xC0 | (run - 1));
+        run = 0;
+      }
+      continue;
+    }
+    if (run > 0) {
+      out.push_back(0xC0 | (run - 1));
+      run = 0;
+    }
+    const int hash = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + 255 * 11) % 64;
+    if (memcmp(seen[hash], pixel, 3) == 0 && seen[hash][3] == 255) {
+      out.push_back(hash);
+    } else {
+      memcpy(seen[hash], pixel, 3);
+      seen[hash][3] = 255;
+      const int dr = static_cast<int8_t>(pixel[0] - previous[0]);
+      const int dg = static_cast<int8_t>(pixel[1] - previous[1]);
+      const int db = static_cast<int8_t>(pixel[2] - previous[2]);
+      const int dr_dg = dr - dg;
+      const int db_dg = db - dg;
+      if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+        out.push_back(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+      } else if (dr_dg >= -8 && dr_dg <= 7 && dg >= -32 && dg <= 31 && db_dg >= -8 &&
+        db_dg <= 7)
+      {
+        out.push_back(0x80 | (dg + 32));
+        out.push_back((dr_dg + 8) << 4 | (db_dg + 8));
+      } else {
+        out.insert(out.end(), {0xFE, pixel[0], pixel[1], pixel[2]});
+      }
+    }
+    memcpy(previous, pixel, 3);
+  }
+  out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+}
+
+#ifdef THERMAL_NETWORK_HAS_JPEG
+/// \brief libjpeg error handler that returns to encode_jpeg() instead of calling exit()
+struct JpegError
+{
+  struct jpeg_error_mgr manager;
+  std::jmp_buf jump;
+};
+
+void jpeg_error_exit(j_common_ptr cinfo)
+{
+  std::longjmp(reinterpret_cast<JpegError *>(cinfo->err)->jump, 1);
+}
+
+bool encode_jpeg(
+  const uint8_t * index, std::size_t width, std::size_t height, const PaletteColors & colors,
+  int quality, std::vector<uint8_t> & out)
+{
+  struct jpeg_compress_struct cinfo;
+  JpegError error;
+  cinfo.err = jpeg_std_error(&error.manager);
+  error.manager.error_exit = jpeg_error_exit;
+  // The longjmp does not unwind, so everything with a destructor is created before setjmp
+  std::vector<uint8_t> row(width * 3);
+  unsigned char * buffer = nullptr;
+  unsigned long size = 0;  // NOLINT(runtime/int) as declared by jpeg_mem_dest
+  if (setjmp(error.jump)) {
+    jpeg_destroy_compress(&cinfo);
+    free(buffer);
+    return false;
+  }
+  jpeg_create_compress(&cinfo);
+  jpeg_mem_dest(&cinfo, &buffer, &size);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, std::clamp(quality, 1, 100), TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    const uint8_t * in = index + cinfo.next_scanline * width;
+    for (std::size_t x = 0; x < width; ++x) {
+      memcpy(&row[x * 3], &colors[in[x] * 3], 3);
+    }
+    JSAMPROW rows[1] = {row.data()};
+    jpeg_write_scanlines(&cinfo, rows, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  out.assign(buffer, buffer + size);
+  jpeg_destroy_compress(&cinfo);
+  free(buffer);
+  return true;
+}
+#endif
+}  // namespace
+
+bool parse_image_codec(const std::string & name, ImageCodec & codec)
+{
+  if (name == "png") {
+    codec = ImageCodec::kPng;
+  } else if (name == "qoi") {
+    codec = ImageCodec::kQoi;
+#ifdef THERMAL_NETWORK_HAS_JPEG
+  } else if (name == "jpeg") {
+    codec = ImageCodec::kJpeg;
+#endif
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char * image_codec_name(ImageCodec codec)
+{
+  switch (codec) {
+    case ImageCodec::kPng:
+      return "png";
+    case ImageCodec::kQoi:
+      return "qoi";
+    case ImageCodec::kJpeg:
+      return "jpeg";
+  }
+  return "";
+}
+
+const char * compressed_image_format(ImageCodec codec)
+{
+  switch (codec) {
+    case ImageCodec::kPng:
+      return "rgb8; png compressed rgb8";
+    case ImageCodec::kQoi:
+      return "rgb8; qoi compressed rgb8";
+    case ImageCodec::kJpeg:
+      return "rgb8; jpeg compressed rgb8";
+  }
+  return "";
+}
+
+bool encode_image(
+  ImageCodec codec, const uint8_t * index, std::size_t width, std::size_t height,
+  const PaletteColors & colors, int quality, std::vector<uint8_t> & out)
+{
+  switch (codec) {
+    case ImageCodec::kPng:
+      return encode_png(index, width, height, colors, quality, out);
+    case ImageCodec::kQoi:
+      encode_qoi(index, width, height, colors, out);
+      return true;
+    case ImageCodec::kJpeg:
+#ifdef THERMAL_NETWORK_HAS_JPEG
+      return encode_jpeg(index, width, height, colors, quality, out);
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+}  // namespace thermal_network
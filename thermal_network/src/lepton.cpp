@@ -0,0 +1,54 @@
+/// \file Lepton VoSPI stream layout
+/// \brief Lookup of the sensor layouts
+
+#include "thermal_network/lepton.hpp"
+
+namespace thermal_network
+{
+
+namespace
+{
+constexpr bool buffers_fit()
+{
+  for (const SensorGeometry & geometry : kSensorGeometries) {
+    if (geometry.width > kFrameWidth || geometry.height > kFrameHeight ||
+      geometry.segments > kSegmentsPerFrame || geometry.segment_bytes() > kSegmentBytes ||
+      geometry.frame_bytes() > kFrameBytes ||
+      geometry.video_packets() + geometry.telemetry_packets !=
+      geometry.segments * geometry.packets_per_segment)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(buffers_fit(), "A sensor layout does not fit the frame buffers");
+}  // namespace
+
+bool find_sensor_geometry(
+  const std::string & sensor, const std::string & telemetry, std::size_t & geometry)
+{
+  std::string family;
+  if (sensor == "lepton2" || sensor == "lepton2.5") {
+    family = "lepton2";
+  } else if (sensor == "lepton3" || sensor == "lepton3.1r" || sensor == "lepton3.5") {
+    family = "lepton3";
+  } else {
+    return false;
+  }
+  if (telemetry != "none" && telemetry != "header" && telemetry != "footer") {
+    return false;
+  }
+  for (std::size_t i = 0; i < kSensorGeometryCount; ++i) {
+    const SensorGeometry & candidate = kSensorGeometries[i];
+    if (family == candidate.family && (candidate.telemetry_packets == 0) == (telemetry == "none") &&
+      (telemetry == "none" || candidate.telemetry_footer == (telemetry == "footer")))
+    {
+      geometry = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace thermal_network
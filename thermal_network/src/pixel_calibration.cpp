@@ -0,0 +1,72 @@
+/// \file Radiometric calibration
+/// \brief Implementation of PixelCalibration
+
+#include "thermal_network/pixel_calibration.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <utility>
+
+namespace thermal_network
+{
+
+bool PixelCalibration::read_table(
+  const std::string & file, std::size_t pixels, std::vector<float> & table)
+{
+  std::ifstream stream(file, std::ios::binary | std::ios::ate);
+  if (!stream) {
+    error_ = "Cannot open calibration table " + file;
+    return false;
+  }
+  const std::streamoff size = stream.tellg();
+  if (size != static_cast<std::streamoff>(pixels * sizeof(float))) {
+    error_ = "Calibration table " + file + " has " + std::to_string(size) + " bytes instead of " +
+      std::to_string(pixels * sizeof(float));
+    return false;
+  }
+  table.resize(pixels);
+  stream.seekg(0);
+  if (!stream.read(reinterpret_cast<char *>(table.data()), size)) {
+    error_ = "Cannot read calibration table " + file;
+    return false;
+  }
+  if (!std::all_of(table.begin(), table.end(), [](float value) {return std::isfinite(value);})) {
+    error_ = "Calibration table " + file + " holds a value that is not finite";
+    return false;
+  }
+  return true;
+}
+
+bool PixelCalibration::load(
+  const std::string & gain_file, const std::string & offset_file, std::size_t pixels)
+{
+  gain_.clear();
+  offset_.clear();
+  error_.clear();
+  std::vector<float> gain(pixels, 1.0f);
+  std::vector<float> offset(pixels, 0.0f);
+  if (!gain_file.empty() && !read_table(gain_file, pixels, gain)) {
+    return false;
+  }
+  if (!offset_file.empty() && !read_table(offset_file, pixels, offset)) {
+    return false;
+  }
+  if (gain_file.empty() && offset_file.empty()) {
+    return true;
+  }
+  gain_ = std::move(gain);
+  offset_ = std::move(offset);
+  return true;
+}
+
+void PixelCalibration::apply(RawFrame & raw) const
+{
+  const std::size_t count = std::min(raw.size(), gain_.size());
+  calibrate(raw.pixels.data(), count, gain_.data(), offset_.data());
+
+  // The correction can clamp a pixel to zero, which stays out of the minimum as when decoding
+  update_range(raw);
+}
+
+}  // namespace thermal_network
@@ -0,0 +1,294 @@
+/// \file Raw segment recordings
+/// \brief Implementation of SegmentRecorder and SegmentReplay
+
+#include "thermal_network/segment_recording.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+namespace thermal_network
+{
+
+namespace
+{
+constexpr char kMagic[8] = {'T', 'H', 'R', 'M', 'S', 'E', 'G', '1'};
+constexpr uint32_t kVersion = 1;
+
+struct FileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t record_header_size;
+};
+
+/// \brief Buffer size at which the recorder writes, about 100 segments
+constexpr std::size_t kFlushBytes = 1 << 20;
+/// \brief Room for a full buffer and one more datagram of the largest size UDP has
+constexpr std::size_t kBufferBytes = kFlushBytes + sizeof(SegmentRecordHeader) + (1 << 16);
+
+std::size_t padded(std::size_t size)
+{
+  return (size + 7) & ~static_cast<std::size_t>(7);
+}
+
+bool valid_header(const FileHeader & header)
+{
+  return memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.version == kVersion &&
+         header.record_header_size == sizeof(SegmentRecordHeader);
+}
+}  // namespace
+
+SegmentRecorder::~SegmentRecorder()
+{
+  close();
+}
+
+bool SegmentRecorder::open(const std::string & path)
+{
+  close();
+  if ((fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) < 0) {
+    set_error("Opening " + path + " failed");
+    return false;
+  }
+
+  // A new file gets the header, an existing one has to be a recording of the same format
+  struct stat info;
+  if (fstat(fd_, &info) < 0) {
+    set_error("Reading the size of " + path + " failed");
+    close();
+    return false;
+  }
+  FileHeader header;
+  if (info.st_size == 0) {
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.record_header_size = sizeof(SegmentRecordHeader);
+    const uint8_t * bytes = reinterpret_cast<const uint8_t *>(&header);
+    if (!write_out(std::vector<uint8_t>(bytes, bytes + sizeof(header)))) {
+      close();
+      return false;
+    }
+  } else {
+    if (pread(fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+      !valid_header(header))
+    {
+      error_ = path + " is not a segment recording";
+      close();
+      return false;
+    }
+
+    // A crash can leave the last record cut short, appending after it would shift every
+    // record that follows, so the file is cut back to the end of the last complete one
+    const std::size_t size = info.st_size;
+    std::size_t end = sizeof(FileHeader);
+    SegmentRecordHeader record;
+    while (end + sizeof(record) <= size &&
+      pread(fd_, &record, sizeof(record), end) == static_cast<ssize_t>(sizeof(record)) &&
+      end + sizeof(record) + padded(record.size) <= size)
+    {
+      end += sizeof(record) + padded(record.size);
+    }
+    if (end < size && ftruncate(fd_, end) < 0) {
+      set_error("Cutting the incomplete record off " + path + " failed");
+      close();
+      return false;
+    }
+  }
+
+  buffer_.reserve(kBufferBytes);
+  full_.reserve(kBufferBytes);
+  failed_ = false;
+  running_ = true;
+  thread_ = std::thread(&SegmentRecorder::run, this);
+  return true;
+}
+
+void SegmentRecorder::close()
+{
+  if (fd_ < 0) {
+    return;
+  }
+  flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  wakeup_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  ::close(fd_);
+  fd_ = -1;
+  buffer_.clear();
+}
+
+bool SegmentRecorder::record(
+  const uint8_t * data, std::size_t size, bool truncated, int64_t stamp_ns, uint16_t stream)
+{
+  if (fd_ < 0 || failed_) {
+    return false;
+  }
+  SegmentRecordHeader header;
+  header.stamp_ns = stamp_ns;
+  header.size = size;
+  header.stream = stream;
+  header.flags = truncated ? kSegmentTruncated : 0;
+  const uint8_t * bytes = reinterpret_cast<const uint8_t *>(&header);
+  buffer_.insert(buffer_.end(), bytes, bytes + sizeof(header));
+  buffer_.insert(buffer_.end(), data, data + size);
+  buffer_.resize(buffer_.size() + padded(size) - size, 0);
+  if (buffer_.size() >= kFlushBytes) {
+    // While the writer is still busy with the other buffer this one keeps growing, the receive
+    // thread never waits for the disk
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!has_full_) {
+      std::swap(buffer_, full_);
+      has_full_ = true;
+      wakeup_.notify_one();
+    }
+  }
+  return true;
+}
+
+bool SegmentRecorder::flush()
+{
+  if (fd_ < 0) {
+    return false;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  written_.wait(lock, [this]() {return !has_full_ || failed_;});
+  if (!failed_ && !buffer_.empty()) {
+    std::swap(buffer_, full_);
+    has_full_ = true;
+    wakeup_.notify_one();
+    written_.wait(lock, [this]() {return !has_full_ || failed_;});
+  }
+  return !failed_;
+}
+
+void SegmentRecorder::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wakeup_.wait(lock, [this]() {return has_full_ || !running_;});
+    if (!has_full_) {
+      return;
+    }
+    // Swapping keeps both buffers allocated, full_ is only touched here until has_full_ is reset
+    lock.unlock();
+    const bool written = write_out(full_);
+    lock.lock();
+    full_.clear();
+    has_full_ = false;
+    if (!written) {
+      failed_ = true;
+    }
+    written_.notify_all();
+    if (!written) {
+      return;
+    }
+  }
+}
+
+bool SegmentRecorder::write_out(const std::vector<uint8_t> & bytes)
+{
+  std::size_t written = 0;
+  while (written < bytes.size()) {
+    ssize_t result = write(fd_, bytes.data() + written, bytes.size() - written);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result < 0) {
+      set_error("Writing the recording failed");
+      return false;
+    }
+    written += result;
+  }
+  return true;
+}
+
+void SegmentRecorder::set_error(const std::string & what)
+{
+  error_ = what + ": " + strerror(errno);
+}
+
+SegmentReplay::~SegmentReplay()
+{
+  close();
+}
+
+bool SegmentReplay::open(const std::string & path)
+{
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error_ = "Opening " + path + " failed: " + strerror(errno);
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) < 0 || static_cast<std::size_t>(info.st_size) < sizeof(FileHeader)) {
+    error_ = path + " is not a segment recording";
+    ::close(fd);
+    return false;
+  }
+  void * data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    error_ = "Mapping " + path + " failed: " + strerror(errno);
+    return false;
+  }
+  data_ = static_cast<const uint8_t *>(data);
+  size_ = info.st_size;
+  FileHeader header;
+  memcpy(&header, data_, sizeof(header));
+  if (!valid_header(header)) {
+    error_ = path + " is not a segment recording";
+    close();
+    return false;
+  }
+  madvise(data, size_, MADV_SEQUENTIAL);
+  rewind();
+  return true;
+}
+
+void SegmentReplay::close()
+{
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
+
+bool SegmentReplay::next(SegmentRecord & record)
+{
+  if (data_ == nullptr || offset_ + sizeof(SegmentRecordHeader) > size_) {
+    return false;
+  }
+  SegmentRecordHeader header;
+  memcpy(&header, data_ + offset_, sizeof(header));
+  const std::size_t end = offset_ + sizeof(header) + padded(header.size);
+  if (end > size_) {
+    return false;
+  }
+  record.stamp_ns = header.stamp_ns;
+  record.stream = header.stream;
+  record.truncated = (header.flags & kSegmentTruncated) != 0;
+  record.data = data_ + offset_ + sizeof(header);
+  record.size = header.size;
+  offset_ = end;
+  return true;
+}
+
+void SegmentReplay::rewind()
+{
+  offset_ = sizeof(FileHeader);
+}
+
+}  // namespace thermal_network
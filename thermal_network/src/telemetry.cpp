@@ -0,0 +1,61 @@
+/// \file Lepton telemetry
+/// \brief Implementation of parse_telemetry()
+
+#include "thermal_network/telemetry.hpp"
+
+namespace thermal_network
+{
+
+namespace
+{
+// Word offsets in telemetry row A
+constexpr std::size_t kTimeCounterWord = 1;
+constexpr std::size_t kStatusWord = 3;
+constexpr std::size_t kFrameCounterWord = 20;
+constexpr std::size_t kFpaTemperatureWord = 24;
+constexpr std::size_t kHousingTemperatureWord = 26;
+
+constexpr uint32_t kFfcDesiredBit = 1u << 3;
+constexpr unsigned int kFfcStateShift = 4;
+
+uint16_t word(const uint8_t * row, std::size_t index)
+{
+  return static_cast<uint16_t>((row[index * 2] << 8) | row[index * 2 + 1]);
+}
+
+uint32_t double_word(const uint8_t * row, std::size_t index)
+{
+  return word(row, index) | (static_cast<uint32_t>(word(row, index + 1)) << 16);
+}
+}  // namespace
+
+bool parse_ffc_policy(const std::string & name, FfcPolicy & policy)
+{
+  if (name == "drop") {
+    policy = FfcPolicy::kDrop;
+  } else if (name == "flag") {
+    policy = FfcPolicy::kFlag;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool parse_telemetry(const Frame & frame, Telemetry & telemetry)
+{
+  const SensorGeometry & geometry = kSensorGeometries[frame.geometry];
+  if (geometry.telemetry_packets == 0) {
+    return false;
+  }
+  const uint8_t * row = frame.data.data() + geometry.telemetry_offset() + kPacketHeaderWords * 2;
+  telemetry.time_counter_ms = double_word(row, kTimeCounterWord);
+  telemetry.status = double_word(row, kStatusWord);
+  telemetry.frame_counter = double_word(row, kFrameCounterWord);
+  telemetry.fpa_temperature = word(row, kFpaTemperatureWord);
+  telemetry.housing_temperature = word(row, kHousingTemperatureWord);
+  telemetry.ffc_state = static_cast<FfcState>((telemetry.status >> kFfcStateShift) & 0x03);
+  telemetry.ffc_desired = (telemetry.status & kFfcDesiredBit) != 0;
+  return true;
+}
+
+}  // namespace thermal_network
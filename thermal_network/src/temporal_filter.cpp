@@ -0,0 +1,131 @@
+/// \file Temporal denoising
+/// \brief Implementation of TemporalFilter
+
+#include "thermal_network/temporal_filter.hpp"
+
+#include <algorithm>
+
+namespace thermal_network
+{
+
+namespace
+{
+inline uint16_t median3(uint16_t a, uint16_t b, uint16_t c)
+{
+  return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+inline uint16_t median5(uint16_t a, uint16_t b, uint16_t c, uint16_t d, uint16_t e)
+{
+  // The smallest and the largest of a..d cannot be the median of all five, the median is
+  // the median of the two middle ones of a..d and e
+  return median3(
+    std::max(std::min(a, b), std::min(c, d)), std::min(std::max(a, b), std::max(c, d)), e);
+}
+}  // namespace
+
+bool parse_filter_mode(const std::string & name, FilterMode & mode)
+{
+  if (name == "none") {
+    mode = FilterMode::kNone;
+  } else if (name == "ema") {
+    mode = FilterMode::kEma;
+  } else if (name == "median") {
+    mode = FilterMode::kMedian;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+TemporalFilter::TemporalFilter(FilterMode mode, std::size_t frames)
+: mode_(mode),
+  frames_(std::max<std::size_t>(frames, 1))
+{
+  if (mode_ == FilterMode::kEma) {
+    average_.resize(kFramePixels);
+  } else if (mode_ == FilterMode::kMedian) {
+    history_.resize(frames_);
+    values_.resize(frames_);
+  }
+}
+
+void TemporalFilter::apply(RawFrame & raw)
+{
+  if (!enabled()) {
+    return;
+  }
+  if (mode_ == FilterMode::kEma) {
+    apply_ema(raw.pixels, raw.size());
+  } else {
+    apply_median(raw.pixels, raw.size());
+  }
+  primed_ = true;
+
+  // Neither filter can produce a zero out of non-zero pixels
+  uint16_t min = UINT16_MAX;
+  uint16_t max = 0;
+  for (std::size_t i = 0; i < raw.size(); ++i) {
+    uint16_t value = raw.pixels[i];
+    min = std::min(min, value);
+    max = std::max(max, value);
+  }
+  raw.min = min;
+  raw.max = max;
+}
+
+void TemporalFilter::apply_ema(Pixels & pixels, std::size_t count)
+{
+  float * average = average_.data();
+  if (!primed_) {
+    std::copy(pixels.begin(), pixels.begin() + count, average);
+    return;
+  }
+  const float alpha = 2.0f / (frames_ + 1);
+  for (std::size_t i = 0; i < count; ++i) {
+    average[i] += alpha * (pixels[i] - average[i]);
+    pixels[i] = static_cast<uint16_t>(average[i] + 0.5f);
+  }
+}
+
+void TemporalFilter::apply_median(Pixels & pixels, std::size_t count)
+{
+  if (!primed_) {
+    std::fill(history_.begin(), history_.end(), pixels);
+    newest_ = 0;
+    return;
+  }
+  newest_ = (newest_ + 1) % frames_;
+  history_[newest_] = pixels;
+
+  // The order of the frames does not matter for the median, so the ring is used as is
+  if (frames_ == 3) {
+    const uint16_t * a = history_[0].data();
+    const uint16_t * b = history_[1].data();
+    const uint16_t * c = history_[2].data();
+    for (std::size_t i = 0; i < count; ++i) {
+      pixels[i] = median3(a[i], b[i], c[i]);
+    }
+  } else if (frames_ == 5) {
+    const uint16_t * a = history_[0].data();
+    const uint16_t * b = history_[1].data();
+    const uint16_t * c = history_[2].data();
+    const uint16_t * d = history_[3].data();
+    const uint16_t * e = history_[4].data();
+    for (std::size_t i = 0; i < count; ++i) {
+      pixels[i] = median5(a[i], b[i], c[i], d[i], e[i]);
+    }
+  } else {
+    // Upper median for an even number of frames
+    std::vector<uint16_t> & values = values_;
+    for (std::size_t i = 0; i < count; ++i) {
+      for (std::size_t f = 0; f < frames_; ++f) {
+        values[f] = history_[f][i];
+      }
+      std::nth_element(values.begin(), values.begin() + frames_ / 2, values.end());
+      pixels[i] = values[frames_ / 2];
+    }
+  }
+}
+
+}  // namespace thermal_network
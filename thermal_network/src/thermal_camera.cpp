@@ -0,0 +1,738 @@
+/// \file Per-camera pipeline
+/// \brief Implementation of ThermalCamera
+
+#include "thermal_network/thermal_camera.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "sensor_msgs/image_encodings.hpp"
+#include "thermal_network/allocation_counter.hpp"
+#include "thermal_network/outgoing_message.hpp"
+
+namespace thermal_network
+{
+
+namespace
+{
+/// \brief Whether anyone, in this process or another, subscribes to a publisher
+template<typename PublisherT>
+bool has_subscribers(const PublisherT & publisher)
+{
+  return publisher->get_subscription_count() > 0 ||
+         publisher->get_intra_process_subscription_count() > 0;
+}
+
+/// \brief Fills a region message, temperatures converted the same way as to_celsius()
+void fill_region(
+  const Region & region, const RawFrame & raw, thermal_network::msg::RegionStats & msg)
+{
+  const RegionStats stats = region_stats(raw, region);
+  msg.name = region.name;
+  msg.x = region.x;
+  msg.y = region.y;
+  msg.width = std::min(region.width, raw.width - std::min(region.x, raw.width));
+  msg.height = std::min(region.height, raw.height - std::min(region.y, raw.height));
+  msg.min = static_cast<float>(stats.min / 100.0 - 273.0);
+  msg.max = static_cast<float>(stats.max / 100.0 - 273.0);
+  msg.mean = static_cast<float>(stats.mean / 100.0 - 273.0);
+  msg.hottest_x = stats.hottest_x;
+  msg.hottest_y = stats.hottest_y;
+}
+
+/// \brief Time on the system clock, which the frame stamps are taken from
+int64_t system_now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+}  // namespace
+
+bool parse_image_encoding(const std::string & name, ImageEncoding & encoding)
+{
+  if (name == sensor_msgs::image_encodings::RGB8) {
+    encoding = ImageEncoding::kRgb8;
+  } else if (name == sensor_msgs::image_encodings::MONO8) {
+    encoding = ImageEncoding::kMono8;
+  } else if (name == sensor_msgs::image_encodings::MONO16) {
+    encoding = ImageEncoding::kMono16;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+ThermalCamera::ThermalCamera(
+  rclcpp_lifecycle::LifecycleNode & node, const CameraOptions & options,
+  const std::atomic<Palette> & palette)
+: node_(node),
+  options_(options),
+  palette_(palette),
+  frame_id_(topic("thermal_image")),
+  receiver_(options.receiver),
+  assembler_(options.frame_timeout_ns, options.geometry),
+  queue_(options.queue_size, options.drop_policy),
+  myImageWidth_(kSensorGeometries[options.geometry].width),
+  myImageHeight_(kSensorGeometries[options.geometry].height),
+  change_detector_(options.change_detector, myImageWidth_, myImageHeight_),
+  minValue_(options.range_min),
+  maxValue_(options.range_max),
+  filter_(options.filter_mode, options.filter_frames),
+  agc_(options.agc_clip_percent),
+  index_(kSensorGeometries[options.geometry].pixels())
+{
+  update_scale();
+
+  // Reused messages are published by reference, which with intra-process comms would copy
+  // them into a new unique_ptr for every frame
+  rclcpp::PublisherOptions publisher_options;
+  if (options_.allocation_free) {
+    publisher_options.use_intra_process_comm = rclcpp::IntraProcessSetting::Disable;
+  }
+  // Plain publishers rather than lifecycle ones, an inactive node stops the threads that publish
+  thermal_pub_ = rclcpp::create_publisher<thermal_network::msg::ThermalData>(
+    node_, topic("raw_thermal_tempature"), 10, publisher_options);
+  img_pub_ = rclcpp::create_publisher<sensor_msgs::msg::Image>(
+    node_, topic("thermal_image"), 10, publisher_options);
+  raw_pub_ = rclcpp::create_publisher<thermal_network::msg::ThermalRaw>(
+    node_, topic("thermal_raw"), 10, publisher_options);
+  stats_pub_ = rclcpp::create_publisher<thermal_network::msg::ThermalStats>(
+    node_, topic("thermal_stats"), 10, publisher_options);
+  for (const Region & region : options_.crops) {
+    crop_pubs_.push_back(
+      rclcpp::create_publisher<thermal_network::msg::ThermalRaw>(
+        node_, topic("thermal_crop/" + region.name), 10, publisher_options));
+  }
+  if (options_.preview_factor > 0) {
+    preview_pub_ = rclcpp::create_publisher<thermal_network::msg::ThermalRaw>(
+      node_, topic("thermal_preview"), 10, publisher_options);
+  }
+  if (options_.change_detection) {
+    heartbeat_pub_ = rclcpp::create_publisher<thermal_network::msg::ThermalHeartbeat>(
+      node_, topic("thermal_heartbeat"), 10, publisher_options);
+  }
+  if (options_.allocation_free) {
+    // Sized up front so that not even the first frame grows them, the largest image is RGB8
+    const std::size_t pixels = index_.size();
+    raw_msg_.data.reserve(pixels);
+    temperature_msg_.temp.reserve(pixels);
+    image_msg_.data.reserve(pixels * 3);
+    stats_msg_.rois.reserve(options_.rois.size());
+    raw_msg_.header.frame_id = frame_id_;
+    temperature_msg_.header.frame_id = frame_id_;
+    image_msg_.header.frame_id = frame_id_;
+    stats_msg_.header.frame_id = frame_id_;
+    crop_msgs_.resize(options_.crops.size());
+    for (std::size_t i = 0; i < crop_msgs_.size(); ++i) {
+      crop_msgs_[i].data.reserve(options_.crops[i].width * options_.crops[i].height);
+      crop_msgs_[i].header.frame_id = frame_id_;
+    }
+    preview_msg_.data.reserve(pixels);
+    preview_msg_.header.frame_id = frame_id_;
+    heartbeat_msg_.header.frame_id = frame_id_;
+  }
+  compressed_pub_ = std::make_unique<CompressedPublisher>(
+    node_, topic("thermal_image/compressed"), frame_id_, options_.compressed_codec,
+    options_.compressed_quality);
+#ifdef THERMAL_NETWORK_HAS_CUDA
+  // Keeps intra-process comms even with allocation_free, in-process subscribers take the device
+  // frames over without a copy, which needs a new message for every frame
+  if (options_.cuda) {
+    if (cuda_renderer_.open(index_.size())) {
+      cuda_pub_ = rclcpp::create_publisher<CudaImage>(node_, topic("thermal_image/cuda"), 10);
+    } else {
+      RCLCPP_ERROR_STREAM(node_.get_logger(), "CUDA disabled: " << cuda_renderer_.error());
+    }
+  }
+#else
+  if (options_.cuda) {
+    RCLCPP_ERROR_STREAM(node_.get_logger(), "Built without CUDA, thermal_image/cuda is off");
+  }
+#endif
+}
+
+bool ThermalCamera::open()
+{
+  if (!receiver_.open()) {
+    RCLCPP_ERROR_STREAM(
+      node_.get_logger(), "Port " << options_.receiver.port << ": " << receiver_.error());
+    return false;
+  }
+  const std::string & group = options_.receiver.multicast_group;
+  RCLCPP_INFO_STREAM(
+    node_.get_logger(), "Listening on port " << options_.receiver.port <<
+      (group.empty() ? "" : " of " + group) <<
+      (options_.name.empty() ? "" : " for " + options_.name) << " with a " <<
+      receiver_.receive_buffer_bytes() << " byte receive buffer" <<
+      (receiver_.kernel_timestamps() ? " and kernel timestamps" : ""));
+  return true;
+}
+
+void ThermalCamera::close()
+{
+  receiver_.close();
+  // Segments read before the failure cannot be completed by those after the socket is back
+  assembler_.reset();
+}
+
+bool ThermalCamera::reopen()
+{
+  close();
+  if (!open()) {
+    return false;
+  }
+  socket_reopens_++;
+  return true;
+}
+
+std::string ThermalCamera::topic(const std::string & name) const
+{
+  return options_.name.empty() ? name : options_.name + "/" + name;
+}
+
+void ThermalCamera::update_scale()
+{
+  diff_ = std::max(maxValue_ - minValue_, 1);
+  scale_ = 255 / diff_;
+}
+
+int ThermalCamera::receive()
+{
+  // One batch per call, the socket stays readable for epoll when more is queued so a busy
+  // camera does not starve the others
+  const int64_t start_ns = steady_ns();
+  const uint64_t allocations = thread_allocations();
+  int received = receiver_.receive_batch(false);
+  if (received < 0) {
+    receive_errors_++;
+    RCLCPP_ERROR_STREAM(
+      node_.get_logger(), "Port " << options_.receiver.port << ": " << receiver_.error());
+    return -1;
+  }
+  if (received == 0) {
+    return 0;
+  }
+  const int64_t now_ns = steady_ns();
+  receive_latency_.record(now_ns - start_ns);
+  int queued = 0;
+  for (int i = 0; i < received; ++i) {
+    const SegmentSlot & slot = receiver_.received(i);
+    if (recorder_ != nullptr) {
+      const std::size_t size = std::min(slot.size, slot.data.size());
+      if (!recorder_->record(slot.data.data(), size, slot.truncated, slot.stamp_ns, stream_)) {
+        RCLCPP_ERROR_STREAM(node_.get_logger(), "Recording stopped: " << recorder_->error());
+        recorder_ = nullptr;
+      }
+    }
+    if (assemble(slot.data.data(), slot.size, slot.truncated, slot.stamp_ns, now_ns)) {
+      queued++;
+    }
+  }
+  reassembly_latency_.record(steady_ns() - now_ns);
+  receive_allocations_ += thread_allocations() - allocations;
+  return queued;
+}
+
+int ThermalCamera::replay(const SegmentRecord & record, int64_t stamp_ns)
+{
+  return assemble(record.data, record.size, record.truncated, stamp_ns, steady_ns()) ? 1 : 0;
+}
+
+void ThermalCamera::set_recorder(SegmentRecorder * recorder, uint16_t stream)
+{
+  recorder_ = recorder;
+  stream_ = stream;
+}
+
+bool ThermalCamera::assemble(
+  const uint8_t * data, std::size_t size, bool truncated, int64_t stamp_ns, int64_t now_ns)
+{
+  if (truncated) {
+    truncated_segments_++;
+    RCLCPP_DEBUG_STREAM(node_.get_logger(), "Ignoring truncated datagram");
+    return false;
+  }
+  Frame & frame = queue_.producer_buffer();
+  if (!assembler_.add(data, size, stamp_ns, now_ns, frame)) {
+    return false;
+  }
+  if (!queue_.push()) {
+    RCLCPP_WARN_STREAM_THROTTLE(
+      node_.get_logger(), *node_.get_clock(), 5000,
+      "Frame queue" << (options_.name.empty() ? "" : " of " + options_.name) <<
+        " full, " << queue_.dropped() << " frames dropped so far");
+  }
+  return true;
+}
+
+void ThermalCamera::process()
+{
+  const uint64_t allocations = thread_allocations();
+  const uint64_t cuda_allocations = cuda_allocations_;
+  while (const Frame * frame = queue_.pop()) {
+    process_data(*frame);
+  }
+  worker_allocations_ +=
+    thread_allocations() - allocations - (cuda_allocations_ - cuda_allocations);
+}
+
+void ThermalCamera::publish_raw_frame(
+  const rclcpp::Publisher<thermal_network::msg::ThermalRaw>::SharedPtr & publisher,
+  thermal_network::msg::ThermalRaw * reusable, const RawFrame & raw, const rclcpp::Time & stamp)
+{
+  OutgoingMessage<thermal_network::msg::ThermalRaw> raw_msg(publisher, reusable);
+  thermal_network::msg::ThermalRaw & msg = raw_msg.get();
+  msg.header.stamp = stamp;
+  msg.header.frame_id = frame_id_;
+  msg.data.resize(raw.size());
+  memcpy(msg.data.data(), raw.pixels.data(), raw.size() * sizeof(uint16_t));
+  msg.scale = 0.01f;
+  msg.offset = -273.0f;
+  msg.height = raw.height;
+  msg.width = raw.width;
+  msg.sensor = options_.sensor;
+  msg.frame_counter = has_telemetry_ ? telemetry_.frame_counter : 0;
+  msg.ffc_state = has_telemetry_ ? static_cast<uint8_t>(telemetry_.ffc_state) :
+    thermal_network::msg::ThermalRaw::FFC_UNKNOWN;
+  raw_msg.publish();
+}
+
+void ThermalCamera::publish_raw(const rclcpp::Time & stamp)
+{
+  publish_raw_frame(raw_pub_, reusable(raw_msg_), raw_frame_, stamp);
+}
+
+void ThermalCamera::publish_crops(const rclcpp::Time & stamp)
+{
+  for (std::size_t i = 0; i < crop_pubs_.size(); ++i) {
+    if (!has_subscribers(crop_pubs_[i])) {
+      continue;
+    }
+    crop(raw_frame_, options_.crops[i], resampled_frame_);
+    publish_raw_frame(
+      crop_pubs_[i], options_.allocation_free ? &crop_msgs_[i] : nullptr, resampled_frame_,
+      stamp);
+  }
+}
+
+void ThermalCamera::publish_preview(const rclcpp::Time & stamp)
+{
+  pool(raw_frame_, options_.preview_factor, options_.preview_mode, resampled_frame_);
+  publish_raw_frame(preview_pub_, reusable(preview_msg_), resampled_frame_, stamp);
+}
+
+void ThermalCamera::publish_temperature(const rclcpp::Time & stamp)
+{
+  OutgoingMessage<thermal_network::msg::ThermalData> temp_msg(
+    thermal_pub_, reusable(temperature_msg_));
+  thermal_network::msg::ThermalData & msg = temp_msg.get();
+  msg.header.stamp = stamp;
+  msg.header.frame_id = frame_id_;
+  msg.temp.resize(raw_frame_.size());
+  to_celsius(raw_frame_.pixels.data(), raw_frame_.size(), msg.temp.data());
+  msg.height = myImageHeight_;
+  msg.width = myImageWidth_;
+  temp_msg.publish();
+}
+
+void ThermalCamera::publish_stats(const rclcpp::Time & stamp)
+{
+  OutgoingMessage<thermal_network::msg::ThermalStats> stats_msg(
+    stats_pub_, reusable(stats_msg_));
+  thermal_network::msg::ThermalStats & msg = stats_msg.get();
+  msg.header.stamp = stamp;
+  msg.header.frame_id = frame_id_;
+  Region frame;
+  frame.name = "frame";
+  fill_region(frame, raw_frame_, msg.frame);
+  msg.rois.resize(options_.rois.size());
+  for (std::size_t i = 0; i < options_.rois.size(); ++i) {
+    fill_region(options_.rois[i], raw_frame_, msg.rois[i]);
+  }
+  stats_msg.publish();
+}
+
+void ThermalCamera::publish_heartbeat(const rclcpp::Time & stamp)
+{
+  OutgoingMessage<thermal_network::msg::ThermalHeartbeat> heartbeat_msg(
+    heartbeat_pub_, reusable(heartbeat_msg_));
+  thermal_network::msg::ThermalHeartbeat & msg = heartbeat_msg.get();
+  msg.header.stamp = stamp;
+  msg.header.frame_id = frame_id_;
+  msg.frames_since_change = frames_since_change_;
+  msg.max_block_delta = static_cast<float>(change_detector_.max_delta() / 100.0);
+  msg.changed_blocks = change_detector_.changed_blocks();
+  msg.frame_counter = has_telemetry_ ? telemetry_.frame_counter : 0;
+  heartbeat_msg.publish();
+}
+
+void ThermalCamera::update_colormap()
+{
+  colormap_.set_palette(palette_);
+  if (options_.histogram_agc) {
+    agc_.equalize(raw_frame_, agc_first_, agc_index_);
+    colormap_.set_mapping(agc_first_, agc_index_);
+    return;
+  }
+
+  if (options_.auto_range_min) {
+    minValue_ = raw_frame_.min;
+  }
+  if (options_.auto_range_max) {
+    maxValue_ = raw_frame_.max;
+  }
+  if (options_.auto_range_min || options_.auto_range_max) {
+    update_scale();
+  }
+  colormap_.set_range(minValue_, maxValue_, scale_);
+}
+
+void ThermalCamera::publish_image(const rclcpp::Time & stamp, int64_t colorize_start_ns)
+{
+  OutgoingMessage<sensor_msgs::msg::Image> image_msg(img_pub_, reusable(image_msg_));
+  sensor_msgs::msg::Image & thermal_image_msg = image_msg.get();
+  const std::size_t pixels = raw_frame_.size();
+  switch (options_.image_encoding) {
+    case ImageEncoding::kRgb8:
+      thermal_image_msg.data.resize(pixels * 3);
+      colormap_.colorize(raw_frame_.pixels.data(), pixels, thermal_image_msg.data.data());
+      thermal_image_msg.encoding = sensor_msgs::image_encodings::RGB8;
+      thermal_image_msg.step = myImageWidth_ * 3;
+      break;
+    case ImageEncoding::kMono8:
+      thermal_image_msg.data.resize(pixels);
+      colormap_.indices(raw_frame_.pixels.data(), pixels, thermal_image_msg.data.data());
+      thermal_image_msg.encoding = sensor_msgs::image_encodings::MONO8;
+      thermal_image_msg.step = myImageWidth_;
+      break;
+    case ImageEncoding::kMono16:
+      thermal_image_msg.data.resize(pixels * sizeof(uint16_t));
+      memcpy(thermal_image_msg.data.data(), raw_frame_.pixels.data(), pixels * sizeof(uint16_t));
+      thermal_image_msg.encoding = sensor_msgs::image_encodings::MONO16;
+      thermal_image_msg.step = myImageWidth_ * 2;
+      break;
+  }
+  colorize_latency_.record(steady_ns() - colorize_start_ns);
+
+  thermal_image_msg.header.stamp = stamp;
+  thermal_image_msg.header.frame_id = frame_id_;
+  thermal_image_msg.height = myImageHeight_;
+  thermal_image_msg.width = myImageWidth_;
+  thermal_image_msg.is_bigendian = false;
+  image_msg.publish();
+}
+
+void ThermalCamera::publish_compressed(const rclcpp::Time & stamp)
+{
+  // Only the indices are computed here, expanding and encoding runs on the encoder thread
+  colormap_.indices(raw_frame_.pixels.data(), raw_frame_.size(), index_.data());
+  compressed_pub_->submit(
+    index_.data(), myImageWidth_, myImageHeight_, colormap_.palette(), stamp);
+}
+
+bool ThermalCamera::has_cuda_subscribers() const
+{
+#ifdef THERMAL_NETWORK_HAS_CUDA
+  return cuda_pub_ && has_subscribers(cuda_pub_);
+#else
+  return false;
+#endif
+}
+
+void ThermalCamera::publish_cuda([[maybe_unused]] const rclcpp::Time & stamp)
+{
+#ifdef THERMAL_NETWORK_HAS_CUDA
+  // The same mapping as thermal_image, so both show the same colors
+  CudaColormap colormap;
+  colormap.palette = colormap_.palette();
+  colormap.min = minValue_;
+  colormap.max = maxValue_;
+  colormap.scale = scale_;
+  if (options_.histogram_agc) {
+    colormap.first = agc_first_;
+    colormap.mapping = &agc_index_;
+  }
+  auto msg = std::make_unique<CudaImage>();
+  msg->frame = cuda_renderer_.render(raw_frame_, colormap);
+  if (!msg->frame) {
+    RCLCPP_WARN_STREAM_THROTTLE(
+      node_.get_logger(), *node_.get_clock(), 5000, "CUDA: " << cuda_renderer_.error());
+    return;
+  }
+  msg->header.stamp = stamp;
+  msg->header.frame_id = frame_id_;
+  cuda_pub_->publish(std::move(msg));
+#endif
+}
+
+void ThermalCamera::process_data(const Frame & frame)
+{
+  // Frames taken behind the closed shutter are dropped before anything else is spent on them
+  has_telemetry_ = parse_telemetry(frame, telemetry_);
+  if (has_telemetry_) {
+    sensor_frame_counter_ = telemetry_.frame_counter;
+    if (telemetry_.during_ffc()) {
+      ffc_frames_++;
+      if (options_.ffc_policy == FfcPolicy::kDrop) {
+        frames_received_++;
+        // The scene may have drifted while the shutter was closed, so start the history over
+        filter_.reset();
+        return;
+      }
+    }
+  }
+
+  // Stages whose topic nobody listens to or that are throttled are skipped, down to the
+  // decode itself
+  const int64_t now_ns = steady_ns();
+  const bool raw_subscribed = has_subscribers(raw_pub_);
+  const bool temperature_subscribed = has_subscribers(thermal_pub_);
+  const bool image_subscribed = has_subscribers(img_pub_);
+  const bool stats_subscribed = has_subscribers(stats_pub_);
+  const bool compressed_subscribed = compressed_pub_->has_subscribers();
+  const bool crop_subscribed = std::any_of(
+    crop_pubs_.begin(), crop_pubs_.end(),
+    [](const auto & publisher) {return has_subscribers(publisher);});
+  const bool preview_subscribed = preview_pub_ && has_subscribers(preview_pub_);
+  const bool cuda_subscribed = has_cuda_subscribers();
+  const bool heartbeat_subscribed = heartbeat_pub_ && has_subscribers(heartbeat_pub_);
+  const bool outputs_subscribed = raw_subscribed || temperature_subscribed ||
+    image_subscribed || stats_subscribed || compressed_subscribed || crop_subscribed ||
+    preview_subscribed || cuda_subscribed;
+
+  // The throttles only see the frames that are published, with change detection that is
+  // known after the decode
+  bool raw_stage = false;
+  bool temperature_stage = false;
+  bool image_stage = false;
+  bool stats_stage = false;
+  bool compressed_stage = false;
+  bool crop_stage = false;
+  bool preview_stage = false;
+  bool cuda_stage = false;
+  auto offer_to_stages = [&]() {
+      raw_stage = raw_subscribed && options_.raw_throttle.accept(now_ns);
+      temperature_stage = temperature_subscribed && options_.temperature_throttle.accept(now_ns);
+      image_stage = image_subscribed && options_.image_throttle.accept(now_ns);
+      stats_stage = stats_subscribed && options_.stats_throttle.accept(now_ns);
+      compressed_stage = compressed_subscribed && options_.compressed_throttle.accept(now_ns);
+      crop_stage = crop_subscribed && options_.crop_throttle.accept(now_ns);
+      preview_stage = preview_subscribed && options_.preview_throttle.accept(now_ns);
+      cuda_stage = cuda_subscribed && options_.cuda_throttle.accept(now_ns);
+      return raw_stage || temperature_stage || image_stage || stats_stage || compressed_stage ||
+             crop_stage || preview_stage || cuda_stage;
+    };
+  bool output_stage = !options_.change_detection && offer_to_stages();
+  // The filter and the change detector have to see every frame, not only those an output is
+  // due for
+  const bool filter_stage = filter_.enabled() && outputs_subscribed;
+  const bool detect_stage =
+    options_.change_detection && (outputs_subscribed || heartbeat_subscribed);
+  frames_received_++;
+  if (!output_stage && !filter_stage && !detect_stage) {
+    frames_skipped_++;
+    filter_.reset();
+    return;
+  }
+
+  const int64_t decode_start_ns = steady_ns();
+  decode_frame(frame, raw_frame_);
+  if (raw_frame_.zero_pixels != 0) {
+    n_zero_value_drop_frame_++;
+    RCLCPP_DEBUG_STREAM(
+      node_.get_logger(), "Dropping frame with " << raw_frame_.zero_pixels << " zero pixels");
+    return;
+  }
+  if (options_.calibration) {
+    options_.calibration->apply(raw_frame_);
+  }
+  filter_.apply(raw_frame_);
+  const int64_t publish_start_ns = steady_ns();
+  decode_latency_.record(publish_start_ns - decode_start_ns);
+  frames_decoded_++;
+  if (!output_stage && !detect_stage) {
+    return;
+  }
+
+  // Stamped with the reception of the first segment, so the stamp does not move with the load
+  rclcpp::Time stamp(frame.stamp_ns - options_.latency_offset_ns, RCL_SYSTEM_TIME);
+
+  // The reference stays the last frame that went out, so a slow drift adds up until it counts
+  // as a change. A heartbeat goes out whenever no frame did for the heartbeat interval, be it
+  // because the scene did not change or because every output throttled the change away.
+  if (options_.change_detection) {
+    const bool changed = change_detector_.compare(raw_frame_);
+    const bool keyframe_due = options_.keyframe_interval_ns > 0 &&
+      now_ns - last_keyframe_ns_ >= options_.keyframe_interval_ns;
+    if (!changed && !keyframe_due) {
+      unchanged_frames_++;
+    } else {
+      output_stage = offer_to_stages();
+    }
+    if (!output_stage) {
+      frames_since_change_++;
+      if (now_ns - last_heartbeat_ns_ >= options_.heartbeat_interval_ns) {
+        publish_heartbeat(stamp);
+        last_heartbeat_ns_ = now_ns;
+        heartbeats_++;
+      }
+      return;
+    }
+    change_detector_.update_reference();
+    frames_since_change_ = 0;
+    last_keyframe_ns_ = now_ns;
+    last_heartbeat_ns_ = now_ns;
+  }
+  if (raw_stage) {
+    publish_raw(stamp);
+    raw_stage_runs_++;
+  }
+  if (temperature_stage) {
+    publish_temperature(stamp);
+    temperature_stage_runs_++;
+  }
+  // Raw mono16 images need no mapping at all
+  const int64_t colorize_start_ns = steady_ns();
+  if ((image_stage && options_.image_encoding != ImageEncoding::kMono16) || compressed_stage ||
+    cuda_stage)
+  {
+    update_colormap();
+  }
+  if (image_stage) {
+    publish_image(stamp, colorize_start_ns);
+    image_stage_runs_++;
+  }
+  if (stats_stage) {
+    publish_stats(stamp);
+    stats_stage_runs_++;
+  }
+  if (compressed_stage) {
+    publish_compressed(stamp);
+    compressed_stage_runs_++;
+  }
+  if (crop_stage) {
+    publish_crops(stamp);
+    crop_stage_runs_++;
+  }
+  if (preview_stage) {
+    publish_preview(stamp);
+    preview_stage_runs_++;
+  }
+  if (cuda_stage) {
+    const uint64_t allocations = thread_allocations();
+    publish_cuda(stamp);
+    cuda_allocations_ += thread_allocations() - allocations;
+    cuda_stage_runs_++;
+  }
+  publish_latency_.record(steady_ns() - publish_start_ns);
+  frame_latency_.record(system_now_ns() - frame.stamp_ns);
+}
+
+diagnostic_msgs::msg::DiagnosticStatus ThermalCamera::diagnostics()
+{
+  diagnostic_msgs::msg::DiagnosticStatus status;
+  status.name = std::string(node_.get_name()) + ": " +
+    (options_.name.empty() ? "pipeline" : options_.name + " pipeline");
+  status.hardware_id = options_.name.empty() ? "lepton" : "lepton " + options_.name;
+
+  uint64_t decoded = frames_decoded_;
+  const char * stage_names[] = {
+    "raw", "temperature", "image", "stats", "compressed", "crop", "preview", "cuda"};
+  const uint64_t stage_runs[] = {
+    raw_stage_runs_, temperature_stage_runs_, image_stage_runs_, stats_stage_runs_,
+    compressed_stage_runs_, crop_stage_runs_, preview_stage_runs_, cuda_stage_runs_};
+  std::string running;
+  for (std::size_t i = 0; i < last_stage_runs_.size(); ++i) {
+    if (stage_runs[i] > last_stage_runs_[i]) {
+      running += (running.empty() ? "" : ", ") + std::string(stage_names[i]);
+    }
+    last_stage_runs_[i] = stage_runs[i];
+  }
+
+  uint64_t received = frames_received_;
+  uint64_t skipped = frames_skipped_;
+  status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+  if (received == last_frames_received_) {
+    status.level = diagnostic_msgs::msg::DiagnosticStatus::WARN;
+    status.message = "No frames received";
+  } else if (decoded != last_frames_decoded_) {
+    status.message = running.empty() ? std::string("Scene unchanged, sending heartbeats only") :
+      "Stages running: " + running;
+  } else if (skipped != last_frames_skipped_) {
+    status.message = "No subscribers or throttled, frames are not decoded";
+  } else {
+    status.level = diagnostic_msgs::msg::DiagnosticStatus::WARN;
+    status.message = "All frames dropped";
+  }
+  // Overruns lose segments before anything here sees them, so they always count as a warning
+  const uint32_t overruns = receiver_.overruns();
+  if (overruns != last_overruns_ && status.level == diagnostic_msgs::msg::DiagnosticStatus::OK) {
+    status.level = diagnostic_msgs::msg::DiagnosticStatus::WARN;
+    status.message = "Socket receive buffer overran, " +
+      std::to_string(overruns - last_overruns_) + " datagrams lost";
+  }
+  last_frames_received_ = received;
+  last_frames_decoded_ = decoded;
+  last_frames_skipped_ = skipped;
+  last_overruns_ = overruns;
+
+  auto add_value = [&status](const std::string & key, uint64_t value) {
+      diagnostic_msgs::msg::KeyValue pair;
+      pair.key = key;
+      pair.value = std::to_string(value);
+      status.values.push_back(pair);
+    };
+  add_value("port", options_.receiver.port);
+  add_value("frames received", received);
+  add_value("frames decoded", decoded);
+  add_value("frames skipped", skipped);
+  add_value("socket buffer overruns", overruns);
+  add_value("receive errors", receive_errors_);
+  add_value("socket reopens", socket_reopens_);
+  add_value("truncated segments dropped", truncated_segments_);
+  add_value("invalid segments dropped", assembler_.invalid_segments());
+  add_value("orphan segments dropped", assembler_.orphan_segments());
+  add_value("incomplete frames dropped", assembler_.incomplete_frames());
+  add_value("zero value frames dropped", n_zero_value_drop_frame_);
+  add_value("queue frames dropped", queue_.dropped());
+  if (options_.change_detection) {
+    add_value("unchanged frames suppressed", unchanged_frames_);
+    add_value("heartbeats sent", heartbeats_);
+  }
+  if (kSensorGeometries[options_.geometry].telemetry_packets > 0) {
+    add_value(
+      options_.ffc_policy == FfcPolicy::kDrop ? "FFC frames dropped" : "FFC frames flagged",
+      ffc_frames_);
+    add_value("sensor frame counter", sensor_frame_counter_);
+  }
+  add_value("compressed frames replaced", compressed_pub_->replaced());
+  for (std::size_t i = 0; i < last_stage_runs_.size(); ++i) {
+    add_value(std::string(stage_names[i]) + " stage runs", stage_runs[i]);
+  }
+  if (allocation_counting_available()) {
+    add_value("receive heap allocations", receive_allocations_);
+    add_value("worker heap allocations", worker_allocations_);
+  }
+
+  // Quantiles over the period in microseconds, the buckets are a quarter of an octave wide
+  auto add_latency = [&add_value](const std::string & stage, LatencyHistogram & histogram) {
+      const LatencySummary summary = histogram.take();
+      add_value(stage + " count", summary.count);
+      add_value(stage + " p50 us", summary.p50_ns / 1000);
+      add_value(stage + " p99 us", summary.p99_ns / 1000);
+      add_value(stage + " max us", summary.max_ns / 1000);
+    };
+  add_latency("receive", receive_latency_);
+  add_latency("reassembly", reassembly_latency_);
+  add_latency("decode", decode_latency_);
+  add_latency("colorize", colorize_latency_);
+  add_latency("publish", publish_latency_);
+  add_latency("frame latency", frame_latency_);
+  return status;
+}
+
+}  // namespace thermal_network
@@ -1,274 +1,947 @@
-/// \file ROS Node for converting data from Lepton 3.1R to ROS messages
+/// \file ROS Node for converting data from Lepton 2.x and 3.x cameras to ROS messages
 /// \brief Converts raw data received from ethernet to ros messages
 ///
+/// Registered as the component thermal_network::ThermalData with intra-process comms enabled,
+/// subscribers loaded into the same container receive the frames by unique_ptr without
+/// serialization. The thermal_data executable runs the component on its own.
+///
+/// The node is a lifecycle node that configures and activates itself unless autostart is off.
+/// Deactivating it and activating it again rebinds the sockets within milliseconds, a cleanup in
+/// between also reads the parameters again. A socket that fails while active is bound again
+/// with a growing delay, the other cameras are not affected.
+///
 /// PARAMETERS:
-///     \param None
+///     \param autostart (bool) Configure and activate on construction, off to leave the
+///         transitions to a lifecycle manager
+///     \param port (int) UDP port the Lepton segments are received on, when ports is empty
+///     \param ports (int[]) UDP ports of several cameras, one per camera
+///     \param multicast.group (string) IPv4 multicast group the cameras send to, joined on each
+///         port in place of receiving unicast, empty for unicast
+///     \param multicast.interface (string) Interface the group is joined on, by address or name,
+///         empty lets the routing table choose
+///     \param reuse_port (bool) Bind with SO_REUSEPORT, so that a standby node on the same host
+///         can bind the same ports
+///     \param receive_threads (int) Threads reading the sockets, camera i is read by thread
+///         i % receive_threads, one while recording
+///     \param camera_namespaces (string[]) Topic namespace of each camera in ports, defaults to
+///         camera0, camera1... when there are several cameras and none for a single one
+///     \param sensor (string) Camera model, lepton2, lepton2.5, lepton3, lepton3.1r or lepton3.5,
+///         sets the frame size and the number of segments of a frame
+///     \param telemetry (string) Telemetry location configured on the camera, none, header or
+///         footer, parsed for the frame counter and the flat-field correction state
+///     \param ffc_frames (string) Frames the telemetry marks as taken during a flat-field
+///         correction, drop them before decoding or flag them in thermal_raw and publish them
+///     \param calibration.gain_files (string[]) Per-pixel gain table of each camera in ports,
+///         float32 row major, an empty string or a missing entry for none
+///     \param calibration.offset_files (string[]) Per-pixel offset table in centikelvin of each
+///         camera in ports
+///     \param worker_threads (int) Threads decoding and publishing the frames of all cameras, 0 for
+///         one per camera up to the number of cores
+///     \param receive_buffer_bytes (int) Socket receive buffer size, 0 keeps the system default
+///     \param kernel_timestamps (bool) Stamp frames with the kernel receive time of their first
+///         segment, SO_TIMESTAMPNS, instead of the time it was read
+///     \param sensor_latency_ms (double) Time between capture and reception, subtracted from the
+///         stamps
+///     \param receive_batch_size (int) Maximum number of datagrams read per recvmmsg call
+///     \param segment_ring_size (int) Number of preallocated segment slots
+///     \param frame_timeout_ms (int) Time within which all segments of a frame have to arrive
+///     \param frame_queue_size (int) Number of complete frames of a camera that can wait for its
+///         worker thread
+///     \param queue_drop_policy (string) Frame dropped when the queue is full, drop_oldest or
+///         drop_newest
+///     \param auto_range_min (bool) Take the lower end of the colormap range from each frame
+///     \param auto_range_max (bool) Take the upper end of the colormap range from each frame
+///     \param range_min (int) Fixed lower end of the colormap range in centikelvin, 0 to 65535
+///     \param range_max (int) Fixed upper end of the colormap range in centikelvin, above
+///         range_min and at most 65535
+///     \param filter.mode (string) Denoising between decoding and all outputs, none, ema or median
+///     \param filter.frames (int) Number of frames the denoising spans, the moving average uses
+///         alpha = 2 / (frames + 1)
+///     \param agc_mode (string) Mapping of thermal_image onto the palette, linear over the range or
+///         histogram for histogram equalization
+///     \param agc_clip_percent (double) Percentage of the pixels saturating at each end of the
+///         palette with histogram equalization
+///     \param decode_kernels (string) Decode implementation, auto, scalar, sse4.1, avx2 or neon
+///     \param palette (string) Colormap of thermal_image, ironblack, rainbow or grayscale, can be
+///         changed at runtime
+///     \param image_encoding (string) Pixel format of thermal_image, rgb8 colormapped by the node,
+///         mono8 palette indices or mono16 raw centikelvin
+///     \param diagnostics_period_ms (int) Period of the diagnostics
+///     \param record.file (string) Appends every received datagram with its receive stamp and
+///         camera to this recording, empty records nothing
+///     \param replay.file (string) Feeds the cameras from a recording instead of their sockets,
+///         the datagrams of camera i go to the i-th entry of ports
+///     \param replay.rate (double) Replay speed relative to the recording, 0 replays as fast as
+///         the workers decode without dropping frames
+///     \param replay.loop (bool) Starts the replay over at its end
+///     \param allocation_free (bool) Publish reused, pre-sized messages so that the steady state
+///         allocates nothing, in-process subscribers then get copies through the middleware,
+///         except on thermal_image/cuda, which allocates a message for every frame
+///     \param cuda.enabled (bool) Also map the frames onto the palette and convert them to Celsius
+///         on the GPU, for builds with THERMAL_NETWORK_CUDA
+///     \param realtime.lock_memory (bool) Lock all pages of the process into memory at startup
+///     \param realtime.receive_priority (int) SCHED_FIFO priority of the receive thread, 0 keeps
+///         the default scheduling
+///     \param realtime.receive_cpus (int[]) CPUs the receive thread may run on, empty for all
+///     \param realtime.worker_priority (int) SCHED_FIFO priority of the worker threads, 0 keeps
+///         the default scheduling
+///     \param realtime.worker_cpus (int[]) CPUs the worker threads may run on, empty for all
+///     \param <output>.decimation (int) Publish one frame out of this many, for the outputs raw,
+///         temperature, image, stats, compressed, crop, preview and cuda
+///     \param <output>.max_rate (double) Maximum publishing rate in Hz of an output, 0 for none
+///     \param compressed.codec (string) Format of thermal_image/compressed, png, qoi or jpeg when
+///         built against libjpeg
+///     \param compressed.jpeg_quality (int) JPEG quality from 1 to 100
+///     \param compressed.png_level (int) PNG zlib compression level from 1 to 9
+///     \param stats.rois (string[]) Names of the regions of interest published on thermal_stats
+///     \param stats.<name> (int[]) Rectangle of a region of interest, x, y, width and height in
+///         pixels
+///     \param crop.regions (string[]) Names of the regions published as frames of their own on
+///         thermal_crop/<name>
+///     \param crop.<name> (int[]) Rectangle of a crop, x, y, width and height in pixels
+///     \param preview.factor (int) Block size thermal_preview is downscaled by, 0 does not
+///         publish it
+///     \param preview.mode (string) How the pixels of a block are combined, mean or max
+///     \param change_detection.enabled (bool) Publish the frame outputs only when the scene
+///         changed against the last published frame and thermal_heartbeat otherwise
+///     \param change_detection.block_size (int) Width and height in pixels of the compared blocks
+///     \param change_detection.threshold (int) Change of a block mean in centikelvin that counts
+///         the block as changed
+///     \param change_detection.min_blocks (int) Number of changed blocks that make a change
+///     \param change_detection.heartbeat_interval (double) Seconds between heartbeats while no
+///         frame is published, the scene did not change or the throttles held the change back
+///     \param change_detection.keyframe_interval (double) Seconds after which a frame is published
+///         even without a change, 0 for never
 ///
-/// PUBLISHES:
+/// PUBLISHES (under the namespace of each camera):
 ///     \param thermal_image (sensor_msgs::msg::Image) Thermal image with custom colormap
 ///     \param raw_thermal_temperature (thermal_network::msg::ThermalData) Raw temperature data
+///     \param thermal_raw (thermal_network::msg::ThermalRaw) Raw centikelvin values, half the size
+///         of the temperature data
+///     \param thermal_image/compressed (sensor_msgs::msg::CompressedImage) Colormapped image,
+///         encoded on a background thread, PNG is palette indexed. The format is that of
+///         image_transport, whose compressed transport decodes png and jpeg, qoi needs a
+///         subscriber of its own
+///     \param thermal_stats (thermal_network::msg::ThermalStats) Minimum, maximum, mean and
+///         hottest pixel of the frame and of each region of interest
+///     \param thermal_crop/<name> (thermal_network::msg::ThermalRaw) Raw values of a crop, clipped
+///         to the frame
+///     \param thermal_preview (thermal_network::msg::ThermalRaw) Raw values of the downscaled
+///         frame, rows and columns that do not fill a whole block are left out
+///     \param thermal_image/cuda (thermal_network::CudaImage as sensor_msgs::msg::Image) Device
+///         buffers of the colormapped image, raw values and temperatures for subscribers in the
+///         process, an RGB8 image for all others, with cuda.enabled only
+///     \param thermal_heartbeat (thermal_network::msg::ThermalHeartbeat) Sent instead of the
+///         frames while none is published, with change detection only
+///     \param thermal_palette (thermal_network::msg::ThermalPalette) Latched palette the mono8
+///         indices refer to, shared by all cameras
+///     \param /diagnostics (diagnostic_msgs::msg::DiagnosticArray) Frame counters and the
+///         processing stages that ran for each camera, stages without subscribers are skipped
 ///
 /// SUBSCRIBES:
 ///     \param None
 ///
 /// SERVERS:
-///     \param None
+///     \param ~/change_state (lifecycle_msgs::srv::ChangeState) Lifecycle transitions, next to
+///         the other services of a lifecycle node
 ///
 /// CLIENTS:
 ///     \param None
 
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <memory>
+#include <stdexcept>
 #include <string>
-#include <vector>
-#include <arpa/inet.h>
-#include <unistd.h>
 #include <thread>
+#include <vector>
 
+#include "diagnostic_msgs/msg/diagnostic_array.hpp"
+#include "lifecycle_msgs/msg/state.hpp"
 #include "rclcpp/rclcpp.hpp"
-#include "sensor_msgs/msg/image.hpp"
-#include "sensor_msgs/image_encodings.hpp"
-#include "thermal_network/msg/thermal_data.hpp"
+#include "rclcpp_components/register_node_macro.hpp"
+#include "rclcpp_lifecycle/lifecycle_node.hpp"
+#include "thermal_network/msg/thermal_palette.hpp"
+#include "thermal_network/colormap.hpp"
+#include "thermal_network/decode_kernels.hpp"
+#include "thermal_network/image_encoder.hpp"
+#include "thermal_network/latency_histogram.hpp"
+#include "thermal_network/lepton.hpp"
+#include "thermal_network/output_throttle.hpp"
+#include "thermal_network/pixel_calibration.hpp"
+#include "thermal_network/segment_recording.hpp"
+#include "thermal_network/spsc_frame_queue.hpp"
+#include "thermal_network/telemetry.hpp"
+#include "thermal_network/temporal_filter.hpp"
+#include "thermal_network/thermal_camera.hpp"
+#include "thermal_network/thread_tuning.hpp"
+#include "thermal_network/worker_pool.hpp"
+
+namespace thermal_network
+{
 
-using namespace std::chrono_literals;
+/// \brief Epoll data of wakefd_, the cameras are registered with their index
+constexpr uint32_t kWakeupEvent = UINT32_MAX;
+/// \brief First and longest delay before a failed socket is bound again
+constexpr int64_t kReopenMinBackoffNs = 100000000;
+constexpr int64_t kReopenMaxBackoffNs = 5000000000;
 
-class ThermalData : public rclcpp::Node
+class ThermalData : public rclcpp_lifecycle::LifecycleNode
 {
 /// \brief Node that receives data from UDP network and converts it to ROS messages
+///
+/// Configuring reads the parameters and sets up the cameras, activating binds the sockets and
+/// starts the threads. Deactivating stops the threads and releases the sockets, so the node can
+/// be started again, with new parameters after a cleanup, without restarting the process.
 
 public:
+  using CallbackReturn = rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn;
+
   /// \brief Main constructor
-  ThermalData()
-  : Node("ThermalData")
+  /// \param options Options of the node, intra-process comms are always enabled
+  /// \throw std::runtime_error when autostarting fails, so a container refuses to load the
+  ///     component instead of shutting down the whole process
+  explicit ThermalData(const rclcpp::NodeOptions & options = rclcpp::NodeOptions())
+  : LifecycleNode("ThermalData", rclcpp::NodeOptions(options).use_intra_process_comms(true))
   {
-    // Socket settings intialization
-    if ((sockfd_ = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-      RCLCPP_ERROR_STREAM(get_logger(), "Socket creation failed");
-      rclcpp::shutdown();
-    }
+    // Shutting down the context has to end the waits of the receive thread
+    shutdown_callback_ = get_node_base_interface()->get_context()->add_on_shutdown_callback(
+      [this]() {wake();});
 
-    memset(&servaddr_, 0, sizeof(servaddr_));
-    memset(&cliaddr_, 0, sizeof(cliaddr_));
+    // Without a lifecycle manager the node goes through the transitions on its own
+    if (declare_parameter("autostart", true)) {
+      if (configure().id() != lifecycle_msgs::msg::State::PRIMARY_STATE_INACTIVE ||
+        activate().id() != lifecycle_msgs::msg::State::PRIMARY_STATE_ACTIVE)
+      {
+        teardown();
+        remove_shutdown_callback();
+        throw std::runtime_error(error_);
+      }
+    }
+  }
 
-    servaddr_.sin_family = AF_INET;
-    servaddr_.sin_port = htons(8080);
-    servaddr_.sin_addr.s_addr = INADDR_ANY;
+  /// \brief Main destructor that stops the threads and releases the cameras
+  ~ThermalData()
+  {
+    remove_shutdown_callback();
+    stop();
+    teardown();
+  }
 
-    if (bind(sockfd_, (const struct sockaddr *)&servaddr_, sizeof(servaddr_)) < 0) {
-      RCLCPP_ERROR_STREAM(get_logger(), "Bind failed");
-      close(sockfd_);
-      rclcpp::shutdown();
+  /// \brief Reads the parameters and creates the cameras, their sockets stay closed
+  CallbackReturn on_configure(const rclcpp_lifecycle::State &) override
+  {
+    try {
+      setup();
+    } catch (const std::runtime_error & error) {
+      error_ = error.what();
+      teardown();
+      return CallbackReturn::FAILURE;
     }
+    return CallbackReturn::SUCCESS;
+  }
 
-    // Publishers
-    thermal_pub_ = create_publisher<thermal_network::msg::ThermalData>(
-      "raw_thermal_tempature", 10);
-    img_pub_ = create_publisher<sensor_msgs::msg::Image>("thermal_image", 10);
+  /// \brief Binds the sockets and starts receiving
+  CallbackReturn on_activate(const rclcpp_lifecycle::State &) override
+  {
+    return start() ? CallbackReturn::SUCCESS : CallbackReturn::FAILURE;
+  }
 
-    // Running thread to receive thermal data
-    received_thread_ = std::thread(&ThermalData::temp_data, this);
+  /// \brief Stops receiving and closes the sockets
+  CallbackReturn on_deactivate(const rclcpp_lifecycle::State &) override
+  {
+    stop();
+    return CallbackReturn::SUCCESS;
   }
 
-  /// \brief Main destructor that closes the function and merges with the thread
-  ~ThermalData()
+  /// \brief Releases the cameras, configuring again reads the parameters anew
+  CallbackReturn on_cleanup(const rclcpp_lifecycle::State &) override
   {
-    close(sockfd_);
-    if (received_thread_.joinable()) {
-      received_thread_.join();
-    }
+    teardown();
+    return CallbackReturn::SUCCESS;
+  }
+
+  /// \brief Stops and releases everything from any state
+  CallbackReturn on_shutdown(const rclcpp_lifecycle::State &) override
+  {
+    stop();
+    teardown();
+    return CallbackReturn::SUCCESS;
+  }
+
+  /// \brief Goes back to unconfigured after a transition threw
+  CallbackReturn on_error(const rclcpp_lifecycle::State &) override
+  {
+    stop();
+    teardown();
+    return CallbackReturn::SUCCESS;
   }
 
 private:
   // Variables
-  sensor_msgs::msg::Image thermal_image_msg_;
-  thermal_network::msg::ThermalData temp_msg_;
-
-  int sockfd_;
-  struct sockaddr_in servaddr_, cliaddr_;
-  std::thread received_thread_;
-
-  bool autoRangeMin_ = false;
-  bool autoRangeMax_ = false;
-  uint16_t rangeMin_ = 27300; // Minimum temperture range (temp / 100 - 273) celsius
-  uint16_t rangeMax_ = 31500; // Maximum temperture range
-  int myImageWidth_ = 160;
-  int myImageHeight_ = 120;
-  uint16_t minValue_ = rangeMin_;
-  uint16_t maxValue_ = rangeMax_;
-  float diff_ = maxValue_ - minValue_;
-  float scale_ = 255 / diff_;
-  uint16_t n_zero_value_drop_frame_ = 0;
-  std::array<uint8_t, 9840> result_;
-  std::array<std::array<uint8_t, 9840>, 4> shelf_;
-  std::vector<float> temperature_data_ = std::vector<float>(myImageWidth_ * myImageHeight_, 0.0);
-  std::vector<uint8_t> image_data_ = std::vector<uint8_t>(myImageWidth_ * myImageHeight_ * 3);
+  std::vector<std::unique_ptr<ThermalCamera>> cameras_;
+  std::vector<int64_t> ports_;  // Port of each camera
+  std::vector<std::size_t> workers_;  // Worker of each camera
+  std::unique_ptr<WorkerPool> pool_;
+  std::vector<int> epollfds_;  // One per receive thread
+  int wakefd_ = -1;  // eventfd that ends the waits of the receive threads
+  std::vector<std::thread> receive_threads_;
+  std::atomic<bool> running_{false};
+  std::atomic<Palette> palette_{Palette::kIronblack};
+  SegmentRecorder recorder_;
+  SegmentReplay replay_;
+  bool replaying_ = false;
+  double replay_rate_ = 1.0;
+  bool replay_loop_ = false;
+  ThreadTuning receive_tuning_;
+  ThreadTuning worker_tuning_;
+  int diagnostics_period_ms_ = 1000;
+  std::string error_;  // Why the last transition failed
 
   // Create objects
-  rclcpp::Publisher<thermal_network::msg::ThermalData>::SharedPtr thermal_pub_;
-  rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr img_pub_;
-
-  // Custom colorpalette
-  std::vector<int> colormap_ironblack_ =
-  {255, 255, 255, 253, 253, 253, 251, 251, 251, 249, 249, 249,
-    247, 247, 247, 245, 245, 245, 243, 243, 243, 241, 241, 241, 239, 239, 239, 237, 237, 237, 235,
-    235, 235, 233, 233, 233, 231, 231, 231, 229, 229, 229, 227, 227, 227, 225, 225, 225, 223, 223,
-    223, 221, 221, 221, 219, 219, 219, 217, 217, 217, 215, 215, 215, 213, 213, 213, 211, 211, 211,
-    209, 209, 209, 207, 207, 207, 205, 205, 205, 203, 203, 203, 201, 201, 201, 199, 199, 199, 197,
-    197, 197, 195, 195, 195, 193, 193, 193, 191, 191, 191, 189, 189, 189, 187, 187, 187, 185, 185,
-    185, 183, 183, 183, 181, 181, 181, 179, 179, 179, 177, 177, 177, 175, 175, 175, 173, 173, 173,
-    171, 171, 171, 169, 169, 169, 167, 167, 167, 165, 165, 165, 163, 163, 163, 161, 161, 161, 159,
-    159, 159, 157, 157, 157, 155, 155, 155, 153, 153, 153, 151, 151, 151, 149, 149, 149, 147, 147,
-    147, 145, 145, 145, 143, 143, 143, 141, 141, 141, 139, 139, 139, 137, 137, 137, 135, 135, 135,
-    133, 133, 133, 131, 131, 131, 129, 129, 129, 126, 126, 126, 124, 124, 124, 122, 122, 122, 120,
-    120, 120, 118, 118, 118, 116, 116, 116, 114, 114, 114, 112, 112, 112, 110, 110, 110, 108, 108,
-    108, 106, 106, 106, 104, 104, 104, 102, 102, 102, 100, 100, 100, 98, 98, 98, 96, 96, 96, 94,
-    94, 94, 92, 92, 92, 90, 90, 90, 88, 88, 88, 86, 86, 86, 84, 84, 84, 82, 82, 82, 80, 80, 80,
-    78, 78, 78, 76, 76, 76, 74, 74, 74, 72, 72, 72, 70, 70, 70, 68, 68, 68, 66, 66, 66, 64, 64,
-    64, 62, 62, 62, 60, 60, 60, 58, 58, 58, 56, 56, 56, 54, 54, 54, 52, 52, 52, 50, 50, 50, 48,
-    48, 48, 46, 46, 46, 44, 44, 44, 42, 42, 42, 40, 40, 40, 38, 38, 38, 36, 36, 36, 34, 34, 34,
-    32, 32, 32, 30, 30, 30, 28, 28, 28, 26, 26, 26, 24, 24, 24, 22, 22, 22, 20, 20, 20, 18, 18,
-    18, 16, 16, 16, 14, 14, 14, 12, 12, 12, 10, 10, 10, 8, 8, 8, 6, 6, 6, 4, 4, 4, 2, 2, 2, 0, 0,
-    0, 0, 0, 9, 2, 0, 16, 4, 0, 24, 6, 0, 31, 8, 0, 38, 10, 0, 45, 12, 0, 53, 14, 0, 60, 17, 0,
-    67, 19, 0, 74, 21, 0, 82, 23, 0, 89, 25, 0, 96, 27, 0, 103, 29, 0, 111, 31, 0, 118, 36, 0,
-    120, 41, 0, 121, 46, 0, 122, 51, 0, 123, 56, 0, 124, 61, 0, 125, 66, 0, 126, 71, 0, 127, 76,
-    1, 128, 81, 1, 129, 86, 1, 130, 91, 1, 131, 96, 1, 132, 101, 1, 133, 106, 1, 134, 111, 1, 135,
-    116, 1, 136, 121, 1, 136, 125, 2, 137, 130, 2, 137, 135, 3, 137, 139, 3, 138, 144, 3, 138,
-    149, 4, 138, 153, 4, 139, 158, 5, 139, 163, 5, 139, 167, 5, 140, 172, 6, 140, 177, 6, 140,
-    181, 7, 141, 186, 7, 141, 189, 10, 137, 191, 13, 132, 194, 16, 127, 196, 19, 121, 198, 22,
-    116, 200, 25, 111, 203, 28, 106, 205, 31, 101, 207, 34, 95, 209, 37, 90, 212, 40, 85, 214,
-    43, 80, 216, 46, 75, 218, 49, 69, 221, 52, 64, 223, 55, 59, 224, 57, 49, 225, 60, 47, 226,
-    64, 44, 227, 67, 42, 228, 71, 39, 229, 74, 37, 230, 78, 34, 231, 81, 32, 231, 85, 29, 232,
-    88, 27, 233, 92, 24, 234, 95, 22, 235, 99, 19, 236, 102, 17, 237, 106, 14, 238, 109, 12, 239,
-    112, 12, 240, 116, 12, 240, 119, 12, 241, 123, 12, 241, 127, 12, 242, 130, 12, 242, 134, 12,
-    243, 138, 12, 243, 141, 13, 244, 145, 13, 244, 149, 13, 245, 152, 13, 245, 156, 13, 246, 160,
-    13, 246, 163, 13, 247, 167, 13, 247, 171, 13, 248, 175, 14, 248, 178, 15, 249, 182, 16, 249,
-    185, 18, 250, 189, 19, 250, 192, 20, 251, 196, 21, 251, 199, 22, 252, 203, 23, 252, 206, 24,
-    253, 210, 25, 253, 213, 27, 254, 217, 28, 254, 220, 29, 255, 224, 30, 255, 227, 39, 255, 229,
-    53, 255, 231, 67, 255, 233, 81, 255, 234, 95, 255, 236, 109, 255, 238, 123, 255, 240, 137,
-    255, 242, 151, 255, 244, 165, 255, 246, 179, 255, 248, 193, 255, 249, 207, 255, 251, 221, 255,
-    253, 235, 255, 255, 24, -1};
-
-  /// \brief Main function that receives data from udp
-  void temp_data()
+  rclcpp::OnShutdownCallbackHandle shutdown_callback_;
+  rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr param_callback_;
+  rclcpp::Publisher<thermal_network::msg::ThermalPalette>::SharedPtr palette_pub_;
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnostics_pub_;
+  rclcpp::TimerBase::SharedPtr diagnostics_timer_;
+
+  /// \brief Reads the parameters and creates the cameras and the worker pool
+  /// \throw std::runtime_error when the configuration is invalid, see fail()
+  void setup()
   {
-    socklen_t len = sizeof(cliaddr_);
-    while (rclcpp::ok()) {
-      for (int i = 0; i < 4; ++i) {
-        ssize_t received_bytes =
-          recvfrom(
-          sockfd_,
-          shelf_[i].data(), sizeof(shelf_[i]), 0, (struct sockaddr *)&cliaddr_, &len);
-        if (received_bytes < 0) {
-          RCLCPP_ERROR_STREAM(get_logger(), "Receive failed");
-          close(sockfd_);
-          return;
-        }
+    // Parameters
+    CameraOptions camera_options;
+    int port = parameter("port", 8080);
+    std::vector<int64_t> ports = parameter<std::vector<int64_t>>(
+      "ports", std::vector<int64_t>());
+    std::vector<std::string> namespaces = parameter<std::vector<std::string>>(
+      "camera_namespaces", std::vector<std::string>());
+    camera_options.sensor = parameter<std::string>("sensor", "lepton3.1r");
+    std::string telemetry = parameter<std::string>("telemetry", "none");
+    if (!find_sensor_geometry(camera_options.sensor, telemetry, camera_options.geometry)) {
+      fail("Unknown sensor " + camera_options.sensor + " with telemetry " + telemetry);
+    }
+    const SensorGeometry & geometry = kSensorGeometries[camera_options.geometry];
+    RCLCPP_INFO_STREAM(
+      get_logger(), "Receiving " << geometry.width << "x" << geometry.height << " frames in " <<
+        geometry.segments << " segments of " << geometry.segment_bytes() << " bytes");
+    std::string ffc_frames = parameter<std::string>("ffc_frames", "drop");
+    if (!parse_ffc_policy(ffc_frames, camera_options.ffc_policy)) {
+      RCLCPP_ERROR_STREAM(get_logger(), "Unknown ffc_frames " << ffc_frames);
+      camera_options.ffc_policy = FfcPolicy::kDrop;
+    }
+    if (telemetry == "none" && ffc_frames == "flag") {
+      RCLCPP_WARN_STREAM(get_logger(), "FFC frames can only be flagged with telemetry enabled");
+    }
+    std::vector<std::string> gain_files = parameter<std::vector<std::string>>(
+      "calibration.gain_files", std::vector<std::string>());
+    std::vector<std::string> offset_files = parameter<std::vector<std::string>>(
+      "calibration.offset_files", std::vector<std::string>());
+    int worker_threads = parameter("worker_threads", 0);
+    camera_options.receiver.multicast_group = parameter<std::string>("multicast.group", "");
+    camera_options.receiver.multicast_interface =
+      parameter<std::string>("multicast.interface", "");
+    camera_options.receiver.reuse_port = parameter("reuse_port", false);
+    int receive_threads = parameter("receive_threads", 1);
+    camera_options.receiver.receive_buffer_bytes = parameter("receive_buffer_bytes", 0);
+    camera_options.receiver.kernel_timestamps = parameter("kernel_timestamps", true);
+    double sensor_latency_ms = parameter("sensor_latency_ms", 0.0);
+    camera_options.latency_offset_ns = static_cast<int64_t>(sensor_latency_ms * 1e6);
+    camera_options.receiver.batch_size = parameter("receive_batch_size", 16);
+    camera_options.receiver.ring_size = parameter("segment_ring_size", 64);
+    int frame_timeout_ms = parameter("frame_timeout_ms", 200);
+    camera_options.frame_timeout_ns =
+      std::chrono::nanoseconds(std::chrono::milliseconds(frame_timeout_ms)).count();
+    camera_options.queue_size = parameter("frame_queue_size", 4);
+    std::string queue_drop_policy =
+      parameter<std::string>("queue_drop_policy", "drop_oldest");
+    if (!parse_drop_policy(queue_drop_policy, camera_options.drop_policy)) {
+      RCLCPP_ERROR_STREAM(get_logger(), "Unknown queue_drop_policy " << queue_drop_policy);
+      camera_options.drop_policy = DropPolicy::kDropOldest;
+    }
+    camera_options.auto_range_min = parameter("auto_range_min", false);
+    camera_options.auto_range_max = parameter("auto_range_max", false);
+    // Read as int64_t, the uint16_t range would wrap out of range values silently
+    const int64_t range_min = parameter<int64_t>("range_min", 27300);
+    const int64_t range_max = parameter<int64_t>("range_max", 31500);
+    if (range_min < 0 || range_max > UINT16_MAX || range_min >= range_max) {
+      RCLCPP_ERROR_STREAM(
+        get_logger(), "Invalid range_min " << range_min << " and range_max " << range_max <<
+          ", they have to be within 0 to " << UINT16_MAX << " with range_min below range_max");
+      camera_options.range_min = 27300;
+      camera_options.range_max = 31500;
+    } else {
+      camera_options.range_min = static_cast<uint16_t>(range_min);
+      camera_options.range_max = static_cast<uint16_t>(range_max);
+    }
+    std::string agc_mode = parameter<std::string>("agc_mode", "linear");
+    if (agc_mode != "linear" && agc_mode != "histogram") {
+      RCLCPP_ERROR_STREAM(get_logger(), "Unknown agc_mode " << agc_mode);
+    }
+    camera_options.histogram_agc = agc_mode == "histogram";
+    camera_options.agc_clip_percent = parameter("agc_clip_percent", 0.5);
+    std::string filter_mode = parameter<std::string>("filter.mode", "none");
+    if (!parse_filter_mode(filter_mode, camera_options.filter_mode)) {
+      RCLCPP_ERROR_STREAM(get_logger(), "Unknown filter.mode " << filter_mode);
+      camera_options.filter_mode = FilterMode::kNone;
+    }
+    camera_options.filter_frames = std::max(parameter("filter.frames", 3), 1);
+    std::string decode_kernels = parameter<std::string>("decode_kernels", "auto");
+    if (!use_decode_kernels(decode_kernels)) {
+      RCLCPP_ERROR_STREAM(
+        get_logger(), "Decode kernels " << decode_kernels << " are not supported on this CPU");
+    }
+    RCLCPP_INFO_STREAM(
+      get_logger(), "Using " << active_decode_kernels().name << " decode kernels");
+    camera_options.raw_throttle = declare_throttle("raw");
+    camera_options.temperature_throttle = declare_throttle("temperature");
+    camera_options.image_throttle = declare_throttle("image");
+    camera_options.stats_throttle = declare_throttle("stats");
+    camera_options.compressed_throttle = declare_throttle("compressed");
+    camera_options.crop_throttle = declare_throttle("crop");
+    camera_options.preview_throttle = declare_throttle("preview");
+    camera_options.cuda_throttle = declare_throttle("cuda");
+    std::string codec = parameter<std::string>("compressed.codec", "png");
+    if (!parse_image_codec(codec, camera_options.compressed_codec)) {
+      RCLCPP_ERROR_STREAM(get_logger(), "Codec " << codec << " is not available, using png");
+      camera_options.compressed_codec = ImageCodec::kPng;
+    }
+    int jpeg_quality = parameter("compressed.jpeg_quality", 90);
+    int png_level = parameter("compressed.png_level", 6);
+    camera_options.compressed_quality =
+      camera_options.compressed_codec == ImageCodec::kJpeg ? jpeg_quality : png_level;
+    camera_options.rois = declare_regions("stats", "rois");
+    camera_options.crops = declare_regions("crop", "regions");
+    camera_options.preview_factor = std::max(parameter("preview.factor", 0), 0);
+    camera_options.change_detection = parameter("change_detection.enabled", false);
+    camera_options.change_detector.block_size =
+      std::max(parameter("change_detection.block_size", 8), 1);
+    camera_options.change_detector.threshold =
+      std::clamp(parameter("change_detection.threshold", 50), 0, UINT16_MAX);
+    camera_options.change_detector.min_blocks =
+      std::max(parameter("change_detection.min_blocks", 1), 1);
+    camera_options.heartbeat_interval_ns = static_cast<int64_t>(
+      std::max(parameter("change_detection.heartbeat_interval", 1.0), 0.0) * 1e9);
+    camera_options.keyframe_interval_ns = static_cast<int64_t>(
+      std::max(parameter("change_detection.keyframe_interval", 10.0), 0.0) * 1e9);
+    std::string preview_mode = parameter<std::string>("preview.mode", "mean");
+    if (!parse_pool_mode(preview_mode, camera_options.preview_mode)) {
+      RCLCPP_ERROR_STREAM(get_logger(), "Unknown preview.mode " << preview_mode);
+      camera_options.preview_mode = PoolMode::kMean;
+    }
+    camera_options.allocation_free = parameter("allocation_free", false);
+    camera_options.cuda = parameter("cuda.enabled", false);
+    std::string image_encoding = parameter<std::string>("image_encoding", "rgb8");
+    if (!parse_image_encoding(image_encoding, camera_options.image_encoding)) {
+      RCLCPP_ERROR_STREAM(get_logger(), "Unknown image_encoding " << image_encoding);
+      camera_options.image_encoding = ImageEncoding::kRgb8;
+    }
+    bool lock = parameter("realtime.lock_memory", false);
+    receive_tuning_ = declare_tuning("receive");
+    worker_tuning_ = declare_tuning("worker");
+    std::string record_file = parameter<std::string>("record.file", "");
+    std::string replay_file = parameter<std::string>("replay.file", "");
+    replay_rate_ = std::max(parameter("replay.rate", 1.0), 0.0);
+    replay_loop_ = parameter("replay.loop", false);
+    palette_pub_ = rclcpp::create_publisher<thermal_network::msg::ThermalPalette>(
+      *this, "thermal_palette", rclcpp::QoS(1).transient_local());
+    std::string palette = parameter<std::string>("palette", "ironblack");
+    set_palette(palette);
+    param_callback_ = add_on_set_parameters_callback(
+      std::bind(&ThermalData::on_parameters, this, std::placeholders::_1));
+
+    if (ports.empty()) {
+      ports.push_back(port);
+    }
+    if (!namespaces.empty() && namespaces.size() != ports.size()) {
+      fail(
+        "camera_namespaces has " + std::to_string(namespaces.size()) + " entries for " +
+        std::to_string(ports.size()) + " ports");
+    }
+
+    // One pipeline per camera, their sockets are polled by a single receive thread
+    replaying_ = !replay_file.empty();
+    if (replaying_ && !replay_.open(replay_file)) {
+      fail(replay_.error());
+    }
+    if ((wakefd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+      fail(std::string("Eventfd creation failed: ") + strerror(errno));
+    }
+    // Camera i is polled by receive thread i % receive_threads, the recording takes one writer
+    receive_threads = std::clamp<int>(receive_threads, 1, ports.size());
+    if (receive_threads > 1 && !record_file.empty() && !replaying_) {
+      RCLCPP_WARN_STREAM(get_logger(), "Recording with a single receive thread");
+      receive_threads = 1;
+    }
+    for (int i = 0; i < receive_threads && !replaying_; ++i) {
+      int epollfd = epoll_create1(EPOLL_CLOEXEC);
+      if (epollfd < 0) {
+        fail(std::string("Epoll creation failed: ") + strerror(errno));
+      }
+      epollfds_.push_back(epollfd);
+      struct epoll_event event;
+      memset(&event, 0, sizeof(event));
+      event.events = EPOLLIN;
+      event.data.u32 = kWakeupEvent;
+      if (epoll_ctl(epollfd, EPOLL_CTL_ADD, wakefd_, &event) < 0) {
+        fail(std::string("Epoll registration failed: ") + strerror(errno));
+      }
+    }
+    ports_ = ports;
+    for (std::size_t i = 0; i < ports.size(); ++i) {
+      camera_options.receiver.port = ports[i];
+      camera_options.name = !namespaces.empty() ? namespaces[i] :
+        ports.size() > 1 ? "camera" + std::to_string(i) : "";
+      camera_options.calibration = load_calibration(
+        i < gain_files.size() ? gain_files[i] : "", i < offset_files.size() ? offset_files[i] : "",
+        geometry.pixels());
+      cameras_.push_back(
+        std::make_unique<ThermalCamera>(*this, camera_options, palette_));
+    }
+    if (replaying_) {
+      RCLCPP_INFO_STREAM(
+        get_logger(), "Replaying " << replay_file << " at " <<
+          (replay_rate_ > 0.0 ? std::to_string(replay_rate_) + " times its speed" : "full speed"));
+      if (!record_file.empty()) {
+        RCLCPP_WARN_STREAM(get_logger(), "Not recording while replaying");
+      }
+    } else if (!record_file.empty()) {
+      if (!recorder_.open(record_file)) {
+        fail(recorder_.error());
       }
-      process_data();
+      for (std::size_t i = 0; i < cameras_.size(); ++i) {
+        cameras_[i]->set_recorder(&recorder_, i);
+      }
+      RCLCPP_INFO_STREAM(get_logger(), "Recording to " << record_file);
+    }
+
+    // Each camera is drained by one worker so its frame queue keeps a single consumer
+    if (worker_threads <= 0) {
+      worker_threads = std::min<std::size_t>(
+        cameras_.size(), std::max(std::thread::hardware_concurrency(), 1u));
+    }
+    pool_ = std::make_unique<WorkerPool>(worker_threads);
+    for (std::unique_ptr<ThermalCamera> & camera : cameras_) {
+      ThermalCamera * pipeline = camera.get();
+      workers_.push_back(pool_->add([pipeline]() {pipeline->process();}));
+    }
+    RCLCPP_INFO_STREAM(
+      get_logger(), cameras_.size() << " cameras on " << pool_->size() << " worker threads and " <<
+        std::max<std::size_t>(epollfds_.size(), 1) << " receive threads");
+
+    // Publishers
+    diagnostics_pub_ = rclcpp::create_publisher<diagnostic_msgs::msg::DiagnosticArray>(
+      *this, "/diagnostics", 10);
+    diagnostics_period_ms_ = parameter("diagnostics_period_ms", 1000);
+
+    // Everything the hot path touches is allocated by now, locking keeps it from paging out
+    std::string error;
+    if (lock && !lock_memory(error)) {
+      RCLCPP_WARN_STREAM(get_logger(), error);
     }
   }
 
-  /// \brief Processes data received and publishes the temperature data and image
-  void process_data()
+  /// \brief Releases what setup() created, also after it failed half way
+  void teardown()
   {
-    const int * selectedColormap_ = colormap_ironblack_.data();
-    int selectedColormapSize_ = colormap_ironblack_.size();
+    param_callback_.reset();
+    workers_.clear();
+    pool_.reset();
+    cameras_.clear();
+    ports_.clear();
+    recorder_.close();
+    replay_.close();
+    diagnostics_pub_.reset();
+    palette_pub_.reset();
+    for (int epollfd : epollfds_) {
+      close(epollfd);
+    }
+    epollfds_.clear();
+    if (wakefd_ >= 0) {
+      close(wakefd_);
+      wakefd_ = -1;
+    }
+  }
 
-    if (autoRangeMin_ || autoRangeMax_) {
-      if (autoRangeMin_) {
-        maxValue_ = 65535;
+  /// \brief Binds the sockets and starts the receive, worker and diagnostics threads
+  /// \return false when a socket cannot be bound, nothing is running then, see error_
+  bool start()
+  {
+    // A wakeup left over from the previous stop() would end the first wait at once
+    uint64_t wakeups;
+    [[maybe_unused]] ssize_t drained = read(wakefd_, &wakeups, sizeof(wakeups));
+    for (std::size_t i = 0; i < cameras_.size() && !replaying_; ++i) {
+      struct epoll_event event;
+      memset(&event, 0, sizeof(event));
+      event.events = EPOLLIN;
+      event.data.u32 = i;
+      if (!cameras_[i]->open()) {
+        error_ = "Port " + std::to_string(ports_[i]) + " could not be opened";
+      } else if (epoll_ctl(epollfd(i), EPOLL_CTL_ADD, cameras_[i]->fd(), &event) < 0) {
+        error_ = std::string("Epoll registration failed: ") + strerror(errno);
+      } else {
+        continue;
       }
-      if (autoRangeMax_) {
-        minValue_ = 0;
+      RCLCPP_ERROR_STREAM(get_logger(), error_);
+      stop();
+      return false;
+    }
+
+    // Running threads to receive thermal data and to process it
+    std::string error;
+    running_ = true;
+    pool_->start();
+    if (worker_tuning_.enabled() && !pool_->tune(worker_tuning_, error)) {
+      RCLCPP_WARN_STREAM(get_logger(), "Worker threads: " << error);
+    }
+    if (replaying_) {
+      receive_threads_.emplace_back(&ThermalData::replay_data, this);
+    }
+    for (std::size_t shard = 0; shard < epollfds_.size(); ++shard) {
+      receive_threads_.emplace_back(&ThermalData::temp_data, this, shard);
+    }
+    for (std::thread & thread : receive_threads_) {
+      if (receive_tuning_.enabled() && !apply_thread_tuning(thread, receive_tuning_, error)) {
+        RCLCPP_WARN_STREAM(get_logger(), "Receive thread: " << error);
       }
-      for (int iSegment = 1; iSegment <= 4; iSegment++) {
-        for (int i = 0; i < 4920; i++) {
-          if (i % 82 < 2) {
-            continue;
-          }
-          uint16_t value = (shelf_[iSegment - 1][i * 2] << 8) + shelf_[iSegment - 1][i * 2 + 1];
-          if (value == 0) {
-            continue;
-          }
-          if (autoRangeMax_ && (value > maxValue_)) {
-            maxValue_ = value;
-          }
-          if (autoRangeMin_ && (value < minValue_)) {
-            minValue_ = value;
-          }
-        }
+    }
+    diagnostics_timer_ = create_wall_timer(
+      std::chrono::milliseconds(diagnostics_period_ms_),
+      std::bind(&ThermalData::publish_diagnostics, this));
+    return true;
+  }
+
+  /// \brief Stops the threads and closes the sockets, queued frames wait for the next start()
+  void stop()
+  {
+    diagnostics_timer_.reset();
+    wake();
+    for (std::thread & thread : receive_threads_) {
+      thread.join();
+    }
+    receive_threads_.clear();
+    if (pool_) {
+      pool_->stop();
+    }
+    for (std::unique_ptr<ThermalCamera> & camera : cameras_) {
+      camera->close();
+    }
+  }
+
+  /// \brief Ends the waits of the receive thread, which then returns
+  void wake()
+  {
+    running_ = false;
+    if (wakefd_ >= 0) {
+      // Only fails when the counter would overflow, the thread is woken up then anyway
+      const uint64_t wakeup = 1;
+      [[maybe_unused]] ssize_t written = write(wakefd_, &wakeup, sizeof(wakeup));
+    }
+  }
+
+  /// \brief Epoll instance of the receive thread polling a camera
+  int epollfd(std::size_t camera) const {return epollfds_[camera % epollfds_.size()];}
+
+  /// \brief Unregisters the shutdown callback of the context
+  void remove_shutdown_callback()
+  {
+    if (shutdown_callback_.callback.lock()) {
+      get_node_base_interface()->get_context()->remove_on_shutdown_callback(shutdown_callback_);
+    }
+    shutdown_callback_ = rclcpp::OnShutdownCallbackHandle();
+  }
+
+  /// \brief Reads the calibration tables of a camera
+  /// \return nullptr when neither table is given
+  std::shared_ptr<const PixelCalibration> load_calibration(
+    const std::string & gain_file, const std::string & offset_file, std::size_t pixels)
+  {
+    if (gain_file.empty() && offset_file.empty()) {
+      return nullptr;
+    }
+    auto calibration = std::make_shared<PixelCalibration>();
+    if (!calibration->load(gain_file, offset_file, pixels)) {
+      fail(calibration->error());
+    }
+    RCLCPP_INFO_STREAM(
+      get_logger(), "Calibrating with gain " << (gain_file.empty() ? "1" : gain_file) <<
+        " and offset " << (offset_file.empty() ? "0" : offset_file));
+    return calibration;
+  }
+
+  /// \brief Logs a setup failure and aborts the configuration, no thread is running yet
+  [[noreturn]] void fail(const std::string & what)
+  {
+    RCLCPP_ERROR_STREAM(get_logger(), what);
+    throw std::runtime_error(what);
+  }
+
+  /// \brief Declares a parameter on the first configuration and reads it on later ones
+  template<typename ParameterT>
+  ParameterT parameter(const std::string & name, const ParameterT & default_value)
+  {
+    if (!has_parameter(name)) {
+      return declare_parameter<ParameterT>(name, default_value);
+    }
+    return get_parameter(name).get_value<ParameterT>();
+  }
+
+  /// \brief Declares the rate parameters of an output
+  /// \param output Prefix of the parameters
+  OutputThrottle declare_throttle(const std::string & output)
+  {
+    int decimation = parameter(output + ".decimation", 1);
+    double max_rate = parameter(output + ".max_rate", 0.0);
+    return OutputThrottle(decimation, max_rate);
+  }
+
+  /// \brief Declares the scheduling parameters of a thread
+  /// \param thread Name of the thread in the parameters
+  ThreadTuning declare_tuning(const std::string & thread)
+  {
+    ThreadTuning tuning;
+    tuning.priority = parameter("realtime." + thread + "_priority", 0);
+    std::vector<int64_t> cpus = parameter<std::vector<int64_t>>(
+      "realtime." + thread + "_cpus", std::vector<int64_t>());
+    tuning.cpus.assign(cpus.begin(), cpus.end());
+    return tuning;
+  }
+
+  /// \brief Declares the regions of an output
+  /// \param output Name of the output in the parameters
+  /// \param list Parameter under output listing the names of the regions
+  std::vector<Region> declare_regions(const std::string & output, const std::string & list)
+  {
+    std::vector<Region> regions;
+    std::vector<std::string> names = parameter<std::vector<std::string>>(
+      output + "." + list, std::vector<std::string>());
+    for (const std::string & name : names) {
+      // The throttle of the output is declared next to the regions
+      if (name == list || name == "decimation" || name == "max_rate") {
+        fail(output + "." + list + " cannot hold a region named " + name);
       }
-      diff_ = maxValue_ - minValue_;
-      scale_ = 255 / diff_;
+      std::vector<int64_t> rect = parameter<std::vector<int64_t>>(
+        output + "." + name, std::vector<int64_t>());
+      if (rect.size() != 4 ||
+        std::any_of(rect.begin(), rect.end(), [](int64_t v) {return v < 0;}))
+      {
+        fail(output + "." + name + " has to be [x, y, width, height] in pixels");
+      }
+      Region region;
+      region.name = name;
+      region.x = rect[0];
+      region.y = rect[1];
+      region.width = rect[2];
+      region.height = rect[3];
+      regions.push_back(region);
+    }
+    return regions;
+  }
+
+  /// \brief Selects the palette the worker threads render with and publishes it
+  /// \return false when the palette is unknown
+  bool set_palette(const std::string & name)
+  {
+    Palette palette;
+    if (!parse_palette(name, palette)) {
+      RCLCPP_ERROR_STREAM(get_logger(), "Unknown palette " << name);
+      return false;
     }
+    palette_ = palette;
 
-    int row, column;
-    uint16_t value;
-    uint16_t valueFrameBuffer;
-    for (int iSegment = 1; iSegment <= 4; iSegment++) {
-      int ofsRow = 30 * (iSegment - 1);
-      for (int i = 0; i < 4920; i++) {
-        if (i % 82 < 2) {
+    thermal_network::msg::ThermalPalette msg;
+    msg.name = name;
+    const PaletteColors & colors = palette_colors(palette);
+    msg.colors.assign(colors.begin(), colors.end());
+    palette_pub_->publish(msg);
+    return true;
+  }
+
+  /// \brief Applies parameters that can be changed while running
+  rcl_interfaces::msg::SetParametersResult on_parameters(
+    const std::vector<rclcpp::Parameter> & parameters)
+  {
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
+    for (const rclcpp::Parameter & parameter : parameters) {
+      if (parameter.get_name() == "palette" && !set_palette(parameter.as_string())) {
+        result.successful = false;
+        result.reason = "Unknown palette " + parameter.as_string();
+      }
+    }
+    return result;
+  }
+
+  /// \brief Main function that receives data from udp, for the cameras of one receive thread
+  ///
+  /// Sleeps in epoll until a socket is readable or stop() writes to wakefd_. A socket that fails
+  /// is closed and bound again after a delay that doubles with every failed attempt, while the
+  /// other cameras keep going.
+  /// \param shard Receive thread, it polls the cameras whose index modulo the thread count is
+  ///     this
+  void temp_data(std::size_t shard)
+  {
+    const int epollfd = epollfds_[shard];
+    const std::size_t stride = epollfds_.size();
+    std::vector<struct epoll_event> events(cameras_.size() / stride + 2);
+    std::vector<int64_t> reopen_ns(cameras_.size(), 0);  // When to reopen, 0 while open
+    std::vector<int64_t> backoff_ns(cameras_.size(), kReopenMinBackoffNs);
+    while (running_ && rclcpp::ok()) {
+      // Only a failed socket bounds the wait
+      int64_t now_ns = steady_ns();
+      int timeout_ms = -1;
+      for (std::size_t i = shard; i < cameras_.size(); i += stride) {
+        if (reopen_ns[i] != 0) {
+          const int64_t wait_ms = std::max<int64_t>(reopen_ns[i] - now_ns, 0) / 1000000 + 1;
+          timeout_ms = timeout_ms < 0 ? wait_ms : std::min<int64_t>(timeout_ms, wait_ms);
+        }
+      }
+      int ready = epoll_wait(epollfd, events.data(), events.size(), timeout_ms);
+      if (ready < 0) {
+        if (errno == EINTR) {
           continue;
         }
-        valueFrameBuffer = (shelf_[iSegment - 1][i * 2] << 8) + shelf_[iSegment - 1][i * 2 + 1];
-        if (valueFrameBuffer == 0) {
-          n_zero_value_drop_frame_++;
-          break;
+        RCLCPP_ERROR_STREAM(get_logger(), "Epoll wait failed: " << strerror(errno));
+        return;
+      }
+      now_ns = steady_ns();
+      for (int i = 0; i < ready; ++i) {
+        const uint32_t index = events[i].data.u32;
+        if (index == kWakeupEvent) {
+          continue;
         }
-        if (!autoRangeMax_ && (valueFrameBuffer > maxValue_)) {
-          value = maxValue_;
-        } else if (!autoRangeMin_ && (valueFrameBuffer <= minValue_)) {
-          value = minValue_;
-        } else {
-          value = (valueFrameBuffer - minValue_) * scale_;
+        ThermalCamera & camera = *cameras_[index];
+        int queued = camera.receive();
+        if (queued > 0) {
+          pool_->notify(workers_[index]);
+        } else if (queued < 0) {
+          // Closing also drops the frame being assembled, the other cameras keep going
+          epoll_ctl(epollfd, EPOLL_CTL_DEL, camera.fd(), nullptr);
+          camera.close();
+          reopen_ns[index] = now_ns + backoff_ns[index];
+          RCLCPP_WARN_STREAM(
+            get_logger(), "Reopening port " << ports_[index] << " in " <<
+              backoff_ns[index] / 1000000 << " ms");
         }
-        float temperature = (valueFrameBuffer / 100.0) - 273.0;
-        int ofs_r = 3 * value + 0; if (selectedColormapSize_ <= ofs_r) {
-          ofs_r = selectedColormapSize_ - 1;
+      }
+      for (std::size_t i = shard; i < cameras_.size() && running_; i += stride) {
+        if (reopen_ns[i] == 0 || now_ns < reopen_ns[i]) {
+          continue;
         }
-        int ofs_g = 3 * value + 1; if (selectedColormapSize_ <= ofs_g) {
-          ofs_g = selectedColormapSize_ - 1;
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        if (cameras_[i]->reopen() &&
+          epoll_ctl(epollfd, EPOLL_CTL_ADD, cameras_[i]->fd(), &event) == 0)
+        {
+          reopen_ns[i] = 0;
+          backoff_ns[i] = kReopenMinBackoffNs;
+          continue;
         }
-        int ofs_b = 3 * value + 2; if (selectedColormapSize_ <= ofs_b) {
-          ofs_b = selectedColormapSize_ - 1;
+        cameras_[i]->close();
+        backoff_ns[i] = std::min(backoff_ns[i] * 2, kReopenMaxBackoffNs);
+        reopen_ns[i] = now_ns + backoff_ns[i];
+      }
+    }
+  }
+
+  /// \brief Sleeps until a time or until stop() writes to wakefd_
+  /// \return false when woken up by stop()
+  bool sleep_until(std::chrono::steady_clock::time_point deadline)
+  {
+    struct pollfd wakeup = {wakefd_, POLLIN, 0};
+    while (running_) {
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= deadline) {
+        return true;
+      }
+      const int64_t wait_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+      struct timespec timeout;
+      timeout.tv_sec = wait_ns / 1000000000;
+      timeout.tv_nsec = wait_ns % 1000000000;
+      ppoll(&wakeup, 1, &timeout, nullptr);
+    }
+    return false;
+  }
+
+  /// \brief Replays a recording into the cameras in place of temp_data()
+  void replay_data()
+  {
+    // Stamps keep the spacing of the recording, scaled by the rate, but start now
+    const int64_t start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+    const double rate = replay_rate_ > 0.0 ? replay_rate_ : 1.0;
+    auto start = std::chrono::steady_clock::now();
+    int64_t first_ns = 0;
+    int64_t loop_offset_ns = 0;
+    int64_t elapsed_ns = 0;
+    bool first = true;
+    SegmentRecord record;
+    while (running_ && rclcpp::ok()) {
+      if (!replay_.next(record)) {
+        if (!replay_loop_ || first) {
+          RCLCPP_INFO_STREAM(get_logger(), "Replay finished");
+          return;
         }
-        column = (i % 82) - 2 + (myImageWidth_ / 2) * ((i % (82 * 2)) / 82);
-        row = i / 82 / 2 + ofsRow;
-        if (row < myImageHeight_ && column < myImageWidth_) {
-          image_data_[(row * myImageWidth_ + column) * 3 + 0] = selectedColormap_[ofs_b];
-          image_data_[(row * myImageWidth_ + column) * 3 + 1] = selectedColormap_[ofs_g];
-          image_data_[(row * myImageWidth_ + column) * 3 + 2] = selectedColormap_[ofs_r];
-          temperature_data_[row * myImageWidth_ + column] = temperature;
+        replay_.rewind();
+        loop_offset_ns = elapsed_ns + 1;
+        first = true;
+        continue;
+      }
+      if (record.stream >= cameras_.size()) {
+        continue;
+      }
+      if (first) {
+        first_ns = record.stamp_ns - loop_offset_ns;
+        first = false;
+      }
+      elapsed_ns = record.stamp_ns - first_ns;
+      const auto elapsed = std::chrono::nanoseconds(static_cast<int64_t>(elapsed_ns / rate));
+
+      ThermalCamera & camera = *cameras_[record.stream];
+      const std::size_t worker = workers_[record.stream];
+      if (replay_rate_ > 0.0) {
+        // Stopping the node does not wait for a pause in the recording to end
+        if (!sleep_until(start + elapsed)) {
+          return;
+        }
+      } else {
+        // Flat out the worker sets the pace, so a full queue waits instead of dropping
+        while (running_ && camera.queue_full()) {
+          pool_->notify(worker);
+          std::this_thread::yield();
         }
       }
+      if (camera.replay(record, start_ns + elapsed.count()) > 0) {
+        pool_->notify(worker);
+      }
     }
-    if (n_zero_value_drop_frame_ != 0) {
-      n_zero_value_drop_frame_ = 0;
-    }
-    temp_msg_.temp = temperature_data_;
-    temp_msg_.height = myImageHeight_;
-    temp_msg_.width = myImageWidth_;
-    thermal_pub_->publish(temp_msg_);
-    thermal_image_msg_.header.stamp = get_clock()->now();
-    thermal_image_msg_.header.frame_id = "thermal_image";
-    thermal_image_msg_.height = myImageHeight_;
-    thermal_image_msg_.width = myImageWidth_;
-    thermal_image_msg_.encoding = sensor_msgs::image_encodings::RGB8;
-    thermal_image_msg_.is_bigendian = false;
-    thermal_image_msg_.step = myImageWidth_ * 3;
-    thermal_image_msg_.data = image_data_;
-    img_pub_->publish(thermal_image_msg_);
+  }
+
+  /// \brief Publishes which stages ran since the previous diagnostics, for all cameras
+  void publish_diagnostics()
+  {
+    diagnostic_msgs::msg::DiagnosticArray array;
+    array.header.stamp = get_clock()->now();
+    for (std::unique_ptr<ThermalCamera> & camera : cameras_) {
+      array.status.push_back(camera->diagnostics());
+    }
+    diagnostics_pub_->publish(array);
   }
 };
 
-/// \brief Main function
-int main(int argc, char * argv[])
-{
-  /// \brief Spinning the node
-  rclcpp::init(argc, argv);
-  rclcpp::spin(std::make_shared<ThermalData>());
-  rclcpp::shutdown();
-  return 0;
-}
+}  // namespace thermal_network
+
+RCLCPP_COMPONENTS_REGISTER_NODE(thermal_network::ThermalData)
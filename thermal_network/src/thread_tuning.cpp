@@ -0,0 +1,62 @@
+/// \file Real-time thread settings
+/// \brief Implementation of apply_thread_tuning() and lock_memory()
+
+#include "thermal_network/thread_tuning.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace thermal_network
+{
+
+bool apply_thread_tuning(std::thread & thread, const ThreadTuning & tuning, std::string & error)
+{
+  error.clear();
+  auto add_error = [&error](const std::string & what, int code) {
+      error += (error.empty() ? "" : ", ") + what + ": " + strerror(code);
+    };
+
+  if (!tuning.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : tuning.cpus) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &set);
+      }
+    }
+    int result = pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+    if (result != 0) {
+      add_error("Setting the CPU affinity failed", result);
+    }
+  }
+
+  if (tuning.priority > 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = std::clamp(
+      tuning.priority, sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+    int result = pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param);
+    if (result != 0) {
+      add_error("Setting SCHED_FIFO failed", result);
+    }
+  }
+  return error.empty();
+}
+
+bool lock_memory(std::string & error)
+{
+  error.clear();
+  // MCL_FUTURE also covers the stacks and buffers of the threads started afterwards
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+    error = std::string("Locking memory failed: ") + strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace thermal_network
@@ -0,0 +1,200 @@
+/// \file Batched UDP receive engine
+/// \brief Implementation of UdpReceiver
+
+#include "thermal_network/udp_receiver.hpp"
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace thermal_network
+{
+
+UdpReceiver::UdpReceiver(const Options & options)
+: options_(options)
+{
+  options_.batch_size = std::max<std::size_t>(options_.batch_size, 1);
+  options_.ring_size = std::max(options_.ring_size, options_.batch_size);
+
+  ring_.resize(options_.ring_size);
+  msgs_.resize(options_.batch_size);
+  iovs_.resize(options_.batch_size);
+  control_.resize(options_.batch_size);
+}
+
+UdpReceiver::~UdpReceiver()
+{
+  close();
+}
+
+bool UdpReceiver::open()
+{
+  close();
+  if ((sockfd_ = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+    set_error("Socket creation failed");
+    return false;
+  }
+
+  if (options_.receive_buffer_bytes > 0) {
+    // SO_RCVBUFFORCE goes past net.core.rmem_max but needs CAP_NET_ADMIN
+    int size = options_.receive_buffer_bytes;
+    if (setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0 &&
+      setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0)
+    {
+      set_error("Setting socket receive buffer failed");
+      close();
+      return false;
+    }
+  }
+  socklen_t size_len = sizeof(granted_receive_buffer_bytes_);
+  getsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF, &granted_receive_buffer_bytes_, &size_len);
+
+  int enable = 1;
+  kernel_timestamps_enabled_ = false;
+  if (options_.kernel_timestamps) {
+    // Software stamps are CLOCK_REALTIME, the clock the frames are published in
+    kernel_timestamps_enabled_ =
+      setsockopt(sockfd_, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0;
+  }
+
+  // The kernel reports the datagrams it dropped for a full buffer along with each datagram,
+  // counted from 0 for every socket, the total carries on from the sockets before
+  overruns_base_ = overruns_.load(std::memory_order_relaxed);
+  setsockopt(sockfd_, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+
+  if (options_.reuse_port &&
+    setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0)
+  {
+    set_error("Enabling SO_REUSEPORT failed");
+    close();
+    return false;
+  }
+
+  struct sockaddr_in servaddr;
+  memset(&servaddr, 0, sizeof(servaddr));
+  servaddr.sin_family = AF_INET;
+  servaddr.sin_port = htons(options_.port);
+  servaddr.sin_addr.s_addr = INADDR_ANY;
+
+  struct ip_mreqn membership;
+  memset(&membership, 0, sizeof(membership));
+  const bool multicast = !options_.multicast_group.empty();
+  if (multicast) {
+    const std::string & group = options_.multicast_group;
+    const std::string & interface = options_.multicast_interface;
+    if (inet_pton(AF_INET, group.c_str(), &membership.imr_multiaddr) != 1 ||
+      !IN_MULTICAST(ntohl(membership.imr_multiaddr.s_addr)))
+    {
+      error_ = group + " is not an IPv4 multicast group";
+      close();
+      return false;
+    }
+    if (!interface.empty() &&
+      inet_pton(AF_INET, interface.c_str(), &membership.imr_address) != 1 &&
+      (membership.imr_ifindex = if_nametoindex(interface.c_str())) == 0)
+    {
+      set_error("Unknown interface " + interface);
+      close();
+      return false;
+    }
+    // Bound to the group, datagrams sent to the port of this host or of other groups stay out
+    servaddr.sin_addr = membership.imr_multiaddr;
+  }
+
+  if (bind(sockfd_, (const struct sockaddr *)&servaddr, sizeof(servaddr)) < 0) {
+    set_error("Bind failed");
+    close();
+    return false;
+  }
+
+  if (multicast) {
+    if (setsockopt(sockfd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0) {
+      set_error("Joining " + options_.multicast_group + " failed");
+      close();
+      return false;
+    }
+    // Otherwise the socket also gets the groups other sockets of the host joined on its port
+    int disable = 0;
+    setsockopt(sockfd_, IPPROTO_IP, IP_MULTICAST_ALL, &disable, sizeof(disable));
+  }
+  return true;
+}
+
+void UdpReceiver::close()
+{
+  if (sockfd_ >= 0) {
+    ::close(sockfd_);
+    sockfd_ = -1;
+  }
+}
+
+int UdpReceiver::receive_batch(bool wait)
+{
+  const std::size_t batch = options_.batch_size;
+  for (std::size_t i = 0; i < batch; ++i) {
+    SegmentSlot & slot = ring_[(head_ + i) % ring_.size()];
+    iovs_[i].iov_base = slot.data.data();
+    iovs_[i].iov_len = slot.data.size();
+    memset(&msgs_[i].msg_hdr, 0, sizeof(msgs_[i].msg_hdr));
+    msgs_[i].msg_hdr.msg_iov = &iovs_[i];
+    msgs_[i].msg_hdr.msg_iovlen = 1;
+    msgs_[i].msg_hdr.msg_control = control_[i].data();
+    msgs_[i].msg_hdr.msg_controllen = control_[i].size();
+  }
+
+  int received;
+  do {
+    received = recvmmsg(
+      sockfd_, msgs_.data(), batch, wait ? MSG_WAITFORONE : MSG_DONTWAIT, nullptr);
+  } while (received < 0 && errno == EINTR);
+  if (received < 0 && !wait && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return 0;
+  }
+  if (received < 0) {
+    set_error("Receive failed");
+    return -1;
+  }
+
+  // Datagrams without a kernel stamp get the time the batch was read, still before any
+  // processing so the stamp does not depend on the load of the worker
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  const int64_t now_ns = static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+  for (int i = 0; i < received; ++i) {
+    SegmentSlot & slot = ring_[(head_ + i) % ring_.size()];
+    const struct msghdr & hdr = msgs_[i].msg_hdr;
+    slot.size = msgs_[i].msg_len;
+    slot.truncated = (hdr.msg_flags & MSG_TRUNC) != 0;
+    slot.stamp_ns = now_ns;
+    for (struct cmsghdr * cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr;
+      cmsg = CMSG_NXTHDR(const_cast<struct msghdr *>(&hdr), cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+        uint32_t overruns;
+        memcpy(&overruns, CMSG_DATA(cmsg), sizeof(overruns));
+        overruns_.store(overruns_base_ + overruns, std::memory_order_relaxed);
+      } else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+        struct timespec ts;
+        memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+        slot.stamp_ns = static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+      }
+    }
+  }
+
+  batch_start_ = head_;
+  head_ = (head_ + received) % ring_.size();
+  return received;
+}
+
+void UdpReceiver::set_error(const std::string & what)
+{
+  error_ = what + ": " + strerror(errno);
+}
+
+}  // namespace thermal_network
@@ -0,0 +1,105 @@
+/// \file Fixed-size pool of processing threads
+/// \brief Implementation of WorkerPool
+
+#include "thermal_network/worker_pool.hpp"
+
+#include <time.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <utility>
+
+namespace thermal_network
+{
+
+WorkerPool::WorkerPool(std::size_t threads, std::chrono::nanoseconds timeout)
+: timeout_(timeout)
+{
+  workers_.resize(std::max<std::size_t>(threads, 1));
+  for (std::unique_ptr<Worker> & worker : workers_) {
+    worker = std::make_unique<Worker>();
+    sem_init(&worker->wakeup, 0, 0);
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  stop();
+  for (std::unique_ptr<Worker> & worker : workers_) {
+    sem_destroy(&worker->wakeup);
+  }
+}
+
+std::size_t WorkerPool::add(std::function<void()> work)
+{
+  // Round robin, camera i lands on worker i % size()
+  std::size_t index = next_worker_++ % workers_.size();
+  workers_[index]->work.push_back(std::move(work));
+  return index;
+}
+
+void WorkerPool::start()
+{
+  if (running_.exchange(true)) {
+    return;
+  }
+  for (std::unique_ptr<Worker> & worker : workers_) {
+    worker->thread = std::thread(&WorkerPool::run, this, std::ref(*worker));
+  }
+}
+
+bool WorkerPool::tune(const ThreadTuning & tuning, std::string & error)
+{
+  error.clear();
+  for (std::unique_ptr<Worker> & worker : workers_) {
+    if (!worker->thread.joinable()) {
+      continue;
+    }
+    std::string worker_error;
+    if (!apply_thread_tuning(worker->thread, tuning, worker_error)) {
+      // The workers share their settings, so they fail the same way
+      error = worker_error;
+    }
+  }
+  return error.empty();
+}
+
+void WorkerPool::stop()
+{
+  running_ = false;
+  for (std::unique_ptr<Worker> & worker : workers_) {
+    sem_post(&worker->wakeup);
+  }
+  for (std::unique_ptr<Worker> & worker : workers_) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+}
+
+void WorkerPool::notify(std::size_t worker)
+{
+  sem_post(&workers_[worker]->wakeup);
+}
+
+void WorkerPool::run(Worker & worker)
+{
+  while (running_) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    int64_t ns = deadline.tv_nsec + timeout_.count();
+    deadline.tv_sec += ns / 1000000000;
+    deadline.tv_nsec = ns % 1000000000;
+    while (sem_timedwait(&worker.wakeup, &deadline) < 0 && errno == EINTR) {
+    }
+    if (!running_) {
+      return;
+    }
+    for (const std::function<void()> & work : worker.work) {
+      work();
+    }
+  }
+}
+
+}  // namespace thermal_network
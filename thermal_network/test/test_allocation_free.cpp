@@ -0,0 +1,189 @@
+/// \file Allocation free publishing test
+/// \brief A warmed up camera with allocation_free does not allocate on the receive or worker
+/// thread
+///
+/// Run with libthermal_network_allocation_counter.so preloaded, which CMake does, without it
+/// nothing can be counted and the test fails. Frames are sent over the loopback interface to
+/// the camera's socket and every output the camera publishes by reference has a subscriber, so
+/// all of them run.
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_lifecycle/lifecycle_node.hpp"
+#include "sensor_msgs/msg/image.hpp"
+#include "thermal_network/allocation_counter.hpp"
+#include "thermal_network/msg/thermal_data.hpp"
+#include "thermal_network/msg/thermal_raw.hpp"
+#include "thermal_network/msg/thermal_stats.hpp"
+#include "thermal_network/thermal_camera.hpp"
+
+namespace thermal_network
+{
+
+namespace
+{
+constexpr int kWarmupFrames = 20;
+constexpr int kMeasuredFrames = 100;
+
+/// \brief Value of a diagnostics entry, 0 when it is missing
+uint64_t diagnostic_value(
+  const diagnostic_msgs::msg::DiagnosticStatus & status, const std::string & key)
+{
+  for (const auto & pair : status.values) {
+    if (pair.key == key) {
+      return std::stoull(pair.value);
+    }
+  }
+  return 0;
+}
+
+class AllocationFreeTest : public ::testing::Test
+{
+protected:
+  static void SetUpTestSuite() {rclcpp::init(0, nullptr);}
+  static void TearDownTestSuite() {rclcpp::shutdown();}
+
+  void SetUp() override
+  {
+    ASSERT_TRUE(allocation_counting_available()) <<
+      "libthermal_network_allocation_counter.so has to be preloaded";
+
+    // A port of its own for each run, so parallel test runs do not share the socket
+    port_ = static_cast<uint16_t>(40000 + getpid() % 20000);
+    CameraOptions options;
+    options.receiver.port = port_;
+    options.allocation_free = true;
+    node_ = std::make_shared<rclcpp_lifecycle::LifecycleNode>("allocation_free_test");
+    camera_ = std::make_unique<ThermalCamera>(*node_, options, palette_);
+    ASSERT_TRUE(camera_->open());
+
+    listener_ = std::make_shared<rclcpp::Node>("allocation_free_listener");
+    auto qos = rclcpp::QoS(10);
+    subscriptions_.push_back(
+      listener_->create_subscription<thermal_network::msg::ThermalRaw>(
+        "thermal_raw", qos, [](thermal_network::msg::ThermalRaw::ConstSharedPtr) {}));
+    subscriptions_.push_back(
+      listener_->create_subscription<thermal_network::msg::ThermalData>(
+        "raw_thermal_tempature", qos, [](thermal_network::msg::ThermalData::ConstSharedPtr) {}));
+    subscriptions_.push_back(
+      listener_->create_subscription<sensor_msgs::msg::Image>(
+        "thermal_image", qos, [](sensor_msgs::msg::Image::ConstSharedPtr) {}));
+    subscriptions_.push_back(
+      listener_->create_subscription<thermal_network::msg::ThermalStats>(
+        "thermal_stats", qos, [](thermal_network::msg::ThermalStats::ConstSharedPtr) {}));
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    for (const auto & subscription : subscriptions_) {
+      while (subscription->get_publisher_count() == 0) {
+        ASSERT_LT(std::chrono::steady_clock::now(), deadline) << "Publishers never matched";
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+
+    sender_ = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(sender_, 0);
+  }
+
+  void TearDown() override
+  {
+    if (sender_ >= 0) {
+      ::close(sender_);
+    }
+    if (camera_) {
+      camera_->close();
+    }
+  }
+
+  /// \brief Sends one frame to the camera and has it received and processed
+  void feed_frame(int frame_number)
+  {
+    const SensorGeometry & geometry = kSensorGeometries[kDefaultSensorGeometry];
+    struct sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port_);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (std::size_t s = 0; s < geometry.segments; ++s) {
+      std::array<uint8_t, kSegmentBytes> segment{};
+      for (std::size_t p = 0; p < geometry.packets_per_segment; ++p) {
+        uint8_t * packet = segment.data() + p * kPacketBytes;
+        const unsigned int id = (p == 20 ? (s + 1) << 12 : 0) | p;
+        packet[0] = id >> 8;
+        packet[1] = id & 0xFF;
+        for (std::size_t w = 0; w < kPacketPixels; ++w) {
+          // A gradient that moves from frame to frame, never zero
+          const unsigned int value = 29000 + (s * 61 + p + w + frame_number * 13) % 2000;
+          packet[(kPacketHeaderWords + w) * 2] = value >> 8;
+          packet[(kPacketHeaderWords + w) * 2 + 1] = value & 0xFF;
+        }
+      }
+      ASSERT_EQ(
+        sendto(
+          sender_, segment.data(), geometry.segment_bytes(), 0,
+          reinterpret_cast<const struct sockaddr *>(&address), sizeof(address)),
+        static_cast<ssize_t>(geometry.segment_bytes()));
+    }
+
+    int queued = 0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (queued == 0) {
+      ASSERT_LT(std::chrono::steady_clock::now(), deadline) << "Frame never arrived";
+      struct pollfd readable = {camera_->fd(), POLLIN, 0};
+      poll(&readable, 1, 100);
+      const int received = camera_->receive();
+      ASSERT_GE(received, 0);
+      queued += received;
+    }
+    camera_->process();
+  }
+
+  uint16_t port_ = 0;
+  std::atomic<Palette> palette_{Palette::kIronblack};
+  std::shared_ptr<rclcpp_lifecycle::LifecycleNode> node_;
+  std::unique_ptr<ThermalCamera> camera_;
+  std::shared_ptr<rclcpp::Node> listener_;
+  std::vector<rclcpp::SubscriptionBase::SharedPtr> subscriptions_;
+  int sender_ = -1;
+};
+}  // namespace
+
+TEST_F(AllocationFreeTest, WarmCameraDoesNotAllocate)
+{
+  for (int i = 0; i < kWarmupFrames; ++i) {
+    feed_frame(i);
+  }
+  const auto warm = camera_->diagnostics();
+  ASSERT_EQ(diagnostic_value(warm, "frames decoded"), static_cast<uint64_t>(kWarmupFrames));
+  for (const char * stage : {"raw", "temperature", "image", "stats"}) {
+    ASSERT_GT(diagnostic_value(warm, std::string(stage) + " stage runs"), 0u) << stage;
+  }
+
+  for (int i = 0; i < kMeasuredFrames; ++i) {
+    feed_frame(kWarmupFrames + i);
+  }
+  const auto measured = camera_->diagnostics();
+  ASSERT_EQ(
+    diagnostic_value(measured, "frames decoded"),
+    static_cast<uint64_t>(kWarmupFrames + kMeasuredFrames));
+  EXPECT_EQ(
+    diagnostic_value(measured, "receive heap allocations"),
+    diagnostic_value(warm, "receive heap allocations"));
+  EXPECT_EQ(
+    diagnostic_value(measured, "worker heap allocations"),
+    diagnostic_value(warm, "worker heap allocations"));
+}
+
+}  // namespace thermal_network
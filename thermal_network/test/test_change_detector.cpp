@@ -0,0 +1,121 @@
+/// \file Scene change detection tests
+/// \brief Thresholds, block counts, edge blocks and drift of ChangeDetector
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "thermal_network/change_detector.hpp"
+#include "thermal_network/frame_decoder.hpp"
+
+namespace thermal_network
+{
+
+namespace
+{
+RawFrame make_frame(std::size_t width, std::size_t height, uint16_t value)
+{
+  RawFrame raw;
+  raw.width = width;
+  raw.height = height;
+  raw.pixels.fill(value);
+  update_range(raw);
+  return raw;
+}
+
+/// \brief Adds delta to the pixels of a rectangle
+void raise(RawFrame & raw, std::size_t x, std::size_t y, std::size_t size, int delta)
+{
+  for (std::size_t row = y; row < y + size && row < raw.height; ++row) {
+    for (std::size_t column = x; column < x + size && column < raw.width; ++column) {
+      raw.pixels[row * raw.width + column] += delta;
+    }
+  }
+}
+}  // namespace
+
+TEST(ChangeDetector, FirstFrameCountsAsChanged)
+{
+  ChangeDetector detector({}, 160, 120);
+  const RawFrame raw = make_frame(160, 120, 30000);
+  EXPECT_TRUE(detector.compare(raw));
+  EXPECT_EQ(detector.changed_blocks(), 20u * 15u);
+  detector.update_reference();
+  EXPECT_FALSE(detector.compare(raw));
+  EXPECT_EQ(detector.changed_blocks(), 0u);
+  EXPECT_EQ(detector.max_delta(), 0.0);
+
+  detector.reset();
+  EXPECT_TRUE(detector.compare(raw));
+}
+
+TEST(ChangeDetector, NoiseBelowTheThresholdIsIgnored)
+{
+  ChangeDetector detector({}, 160, 120);
+  RawFrame raw = make_frame(160, 120, 30000);
+  detector.compare(raw);
+  detector.update_reference();
+  // Single pixels far off, but every block mean moves by less than 50
+  for (std::size_t i = 0; i < raw.size(); i += 8) {
+    raw.pixels[i] += i % 16 ? 300 : -300;
+  }
+  EXPECT_FALSE(detector.compare(raw));
+  EXPECT_LT(detector.max_delta(), 50.0);
+}
+
+TEST(ChangeDetector, ChangedBlockAboveTheThreshold)
+{
+  ChangeDetector detector({}, 160, 120);
+  RawFrame raw = make_frame(160, 120, 30000);
+  detector.compare(raw);
+  detector.update_reference();
+  raise(raw, 16, 16, 8, 100);
+  EXPECT_TRUE(detector.compare(raw));
+  EXPECT_EQ(detector.changed_blocks(), 1u);
+  EXPECT_DOUBLE_EQ(detector.max_delta(), 100.0);
+}
+
+TEST(ChangeDetector, MinBlocksNeedsThatManyBlocks)
+{
+  ChangeDetector::Options options;
+  options.min_blocks = 2;
+  ChangeDetector detector(options, 160, 120);
+  RawFrame raw = make_frame(160, 120, 30000);
+  detector.compare(raw);
+  detector.update_reference();
+  raise(raw, 0, 0, 8, 100);
+  EXPECT_FALSE(detector.compare(raw));
+  EXPECT_EQ(detector.changed_blocks(), 1u);
+  raise(raw, 80, 64, 8, 100);
+  EXPECT_TRUE(detector.compare(raw));
+  EXPECT_EQ(detector.changed_blocks(), 2u);
+}
+
+TEST(ChangeDetector, EdgeBlocksAreComparedByTheirOwnArea)
+{
+  // 10 columns in blocks of 8 leave an edge block of 2 x 8 pixels
+  ChangeDetector detector({}, 10, 8);
+  RawFrame raw = make_frame(10, 8, 30000);
+  detector.compare(raw);
+  detector.update_reference();
+  raise(raw, 8, 0, 8, 60);
+  EXPECT_TRUE(detector.compare(raw));
+  EXPECT_EQ(detector.changed_blocks(), 1u);
+  EXPECT_DOUBLE_EQ(detector.max_delta(), 60.0);
+}
+
+TEST(ChangeDetector, DriftAddsUpAgainstTheReference)
+{
+  ChangeDetector detector({}, 160, 120);
+  RawFrame raw = make_frame(160, 120, 30000);
+  detector.compare(raw);
+  detector.update_reference();
+  for (int step = 1; step <= 2; ++step) {
+    raise(raw, 0, 0, 160, 20);
+    EXPECT_FALSE(detector.compare(raw)) << "after step " << step;
+  }
+  raise(raw, 0, 0, 160, 20);
+  EXPECT_TRUE(detector.compare(raw));
+}
+
+}  // namespace thermal_network
@@ -0,0 +1,176 @@
+/// \file Decode kernel tests
+/// \brief Every kernel set the host runs against the scalar one, bit for bit
+///
+/// The vector kernels only match because their sources are built without fused multiply-add
+/// and compute the temperatures the way the scalar code does, so a compiler or flag change
+/// shows up here first.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "thermal_network/decode_kernels.hpp"
+#include "thermal_network/frame_decoder.hpp"
+#include "thermal_network/lepton.hpp"
+
+namespace thermal_network
+{
+
+namespace
+{
+/// \brief Odd count, so every kernel runs its tail loop as well
+constexpr std::size_t kValues = UINT16_MAX + 1 - 3;
+
+uint32_t next(uint32_t & seed)
+{
+  seed = seed * 1664525u + 1013904223u;
+  return seed;
+}
+
+/// \brief Every raw value once, in a scrambled order
+std::vector<uint16_t> all_values()
+{
+  std::vector<uint16_t> values(UINT16_MAX + 1);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<uint16_t>(i * 40503u);
+  }
+  return values;
+}
+
+class DecodeKernelsTest : public ::testing::TestWithParam<std::string>
+{
+protected:
+  void SetUp() override
+  {
+    scalar_ = scalar_kernels();
+    kernels_ = find_decode_kernels(GetParam());
+    ASSERT_NE(scalar_, nullptr);
+    if (kernels_ == nullptr) {
+      GTEST_SKIP() << GetParam() << " is not available on this host";
+    }
+  }
+
+  const DecodeKernels * scalar_ = nullptr;
+  const DecodeKernels * kernels_ = nullptr;
+};
+}  // namespace
+
+TEST_P(DecodeKernelsTest, DecodeFrameMatchesScalarForEveryGeometry)
+{
+  uint32_t seed = 1;
+  for (std::size_t g = 0; g < kSensorGeometryCount; ++g) {
+    for (int round = 0; round < 4; ++round) {
+      // Noise over the whole uint16_t range, packet headers and telemetry included, with some
+      // zero pixels and, in the last round, nothing but zeros
+      Frame frame;
+      frame.geometry = g;
+      for (uint8_t & byte : frame.data) {
+        byte = round == 3 ? 0 : next(seed) >> 24;
+      }
+      for (int zeros = 0; round == 1 && zeros < 16; ++zeros) {
+        const std::size_t pixel = next(seed) % kSensorGeometries[g].pixels();
+        const std::size_t offset = kSensorGeometries[g].video_offset() +
+          pixel / kPacketPixels * kPacketBytes + (kPacketHeaderWords + pixel % kPacketPixels) * 2;
+        frame.data[offset] = 0;
+        frame.data[offset + 1] = 0;
+      }
+
+      RawFrame expected;
+      RawFrame actual;
+      expected.pixels.fill(1);
+      actual.pixels.fill(2);
+      scalar_->decode_frame[g](frame, expected);
+      kernels_->decode_frame[g](frame, actual);
+      SCOPED_TRACE("geometry " + std::to_string(g) + " round " + std::to_string(round));
+      ASSERT_EQ(actual.width, expected.width);
+      ASSERT_EQ(actual.height, expected.height);
+      EXPECT_EQ(actual.min, expected.min);
+      EXPECT_EQ(actual.max, expected.max);
+      EXPECT_EQ(actual.zero_pixels, expected.zero_pixels);
+      EXPECT_EQ(
+        memcmp(actual.pixels.data(), expected.pixels.data(), expected.size() * 2), 0);
+    }
+  }
+}
+
+TEST_P(DecodeKernelsTest, NormalizeMatchesScalar)
+{
+  const std::vector<uint16_t> values = all_values();
+  std::vector<uint8_t> expected(kValues);
+  std::vector<uint8_t> actual(kValues);
+  uint32_t seed = 2;
+  for (int round = 0; round < 64; ++round) {
+    uint16_t min = round == 0 ? 0 : next(seed) >> 16;
+    uint16_t max = round == 0 ? UINT16_MAX : next(seed) >> 16;
+    if (min > max) {
+      std::swap(min, max);
+    }
+    if (min == max) {
+      continue;
+    }
+    const float scale = 255.0f / (max - min);
+    scalar_->normalize(values.data() + 1, kValues, min, max, scale, expected.data());
+    kernels_->normalize(values.data() + 1, kValues, min, max, scale, actual.data());
+    ASSERT_EQ(actual, expected) << "range " << min << " to " << max;
+  }
+}
+
+TEST_P(DecodeKernelsTest, ToCelsiusMatchesScalarForEveryValue)
+{
+  const std::vector<uint16_t> values = all_values();
+  std::vector<float> expected(values.size());
+  std::vector<float> actual(values.size());
+  scalar_->to_celsius(values.data(), values.size(), expected.data());
+  kernels_->to_celsius(values.data(), values.size(), actual.data());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    ASSERT_EQ(memcmp(&actual[i], &expected[i], sizeof(float)), 0) << "raw value " << values[i];
+  }
+  // Tails, from an unaligned start
+  scalar_->to_celsius(values.data() + 1, kValues, expected.data());
+  kernels_->to_celsius(values.data() + 1, kValues, actual.data());
+  EXPECT_EQ(memcmp(actual.data(), expected.data(), kValues * sizeof(float)), 0);
+}
+
+TEST_P(DecodeKernelsTest, CalibrateMatchesScalar)
+{
+  const std::vector<uint16_t> values = all_values();
+  std::vector<float> gain(kValues);
+  std::vector<float> offset(kValues);
+  uint32_t seed = 3;
+  for (int round = 0; round < 4; ++round) {
+    // Close to unity like a real table, then wide enough to clamp at both ends
+    const float spread = round < 2 ? 0.01f : 2.0f;
+    for (std::size_t i = 0; i < kValues; ++i) {
+      gain[i] = 1.0f + spread * ((next(seed) >> 8) / 16777216.0f - 0.5f);
+      offset[i] = spread * 1000.0f * ((next(seed) >> 8) / 16777216.0f - 0.5f);
+    }
+    std::vector<uint16_t> expected(values.begin() + 1, values.begin() + 1 + kValues);
+    std::vector<uint16_t> actual = expected;
+    scalar_->calibrate(expected.data(), kValues, gain.data(), offset.data());
+    kernels_->calibrate(actual.data(), kValues, gain.data(), offset.data());
+    ASSERT_EQ(actual, expected) << "round " << round;
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  KernelSets, DecodeKernelsTest, ::testing::Values("scalar", "sse4.1", "avx2", "neon"),
+  [](const ::testing::TestParamInfo<std::string> & info) {
+    std::string name = info.param;
+    name.erase(std::remove(name.begin(), name.end(), '.'), name.end());
+    return name;
+  });
+
+TEST(DecodeKernels, AutoPicksAnAvailableSet)
+{
+  const DecodeKernels * kernels = find_decode_kernels("auto");
+  ASSERT_NE(kernels, nullptr);
+  EXPECT_EQ(find_decode_kernels(kernels->name), kernels);
+  EXPECT_EQ(find_decode_kernels("sse5"), nullptr);
+}
+
+}  // namespace thermal_network
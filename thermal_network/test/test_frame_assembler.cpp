@@ -0,0 +1,172 @@
+/// \file Frame reassembly tests
+/// \brief Orders, duplicates, orphans and timeouts of the segments FrameAssembler is given
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "thermal_network/frame_assembler.hpp"
+
+namespace thermal_network
+{
+
+namespace
+{
+constexpr int64_t kTimeoutNs = 1000000;
+
+/// \brief Segment whose packets all carry the given fill byte, packet 20 the segment number
+std::array<uint8_t, kSegmentBytes> make_segment(
+  const SensorGeometry & geometry, std::size_t number, uint8_t fill)
+{
+  std::array<uint8_t, kSegmentBytes> segment{};
+  for (std::size_t p = 0; p < geometry.packets_per_segment; ++p) {
+    uint8_t * packet = segment.data() + p * kPacketBytes;
+    const unsigned int id = (p == 20 && geometry.segments > 1 ? number << 12 : 0) | p;
+    packet[0] = id >> 8;
+    packet[1] = id & 0xFF;
+    memset(packet + kPacketHeaderWords * 2, fill, kPacketPixels * 2);
+  }
+  return segment;
+}
+
+class FrameAssemblerTest : public ::testing::Test
+{
+protected:
+  const SensorGeometry & geometry_ = kSensorGeometries[kDefaultSensorGeometry];
+  FrameAssembler assembler_{kTimeoutNs};
+  Frame frame_;
+
+  /// \brief Adds segment number, its pixels filled with number as well
+  bool add(std::size_t number, int64_t now_ns = 0)
+  {
+    const auto segment = make_segment(geometry_, number, static_cast<uint8_t>(number));
+    return assembler_.add(segment.data(), geometry_.segment_bytes(), now_ns, now_ns, frame_);
+  }
+
+  /// \brief Fill byte of the pixels in the slot of a segment of the frame
+  uint8_t slot(std::size_t number) const
+  {
+    return frame_.data[(number - 1) * geometry_.segment_bytes() + kPacketHeaderWords * 2];
+  }
+};
+}  // namespace
+
+TEST_F(FrameAssemblerTest, CompletesSegmentsInOrder)
+{
+  EXPECT_FALSE(add(1, 10));
+  EXPECT_FALSE(add(2));
+  EXPECT_FALSE(add(3));
+  EXPECT_TRUE(add(4));
+  EXPECT_EQ(assembler_.complete_frames(), 1u);
+  EXPECT_EQ(assembler_.incomplete_frames(), 0u);
+  EXPECT_EQ(frame_.stamp_ns, 10);
+  EXPECT_EQ(frame_.geometry, kDefaultSensorGeometry);
+  for (std::size_t number = 1; number <= 4; ++number) {
+    EXPECT_EQ(slot(number), number);
+  }
+}
+
+TEST_F(FrameAssemblerTest, PlacesOutOfOrderSegmentsInTheirSlots)
+{
+  EXPECT_FALSE(add(1));
+  EXPECT_FALSE(add(4));
+  EXPECT_FALSE(add(2));
+  EXPECT_TRUE(add(3));
+  EXPECT_EQ(assembler_.complete_frames(), 1u);
+  for (std::size_t number = 1; number <= 4; ++number) {
+    EXPECT_EQ(slot(number), number);
+  }
+}
+
+TEST_F(FrameAssemblerTest, DuplicateSegmentDropsTheFrame)
+{
+  EXPECT_FALSE(add(1));
+  EXPECT_FALSE(add(2));
+  EXPECT_FALSE(add(2));
+  EXPECT_EQ(assembler_.incomplete_frames(), 1u);
+  EXPECT_EQ(assembler_.orphan_segments(), 1u);
+  // The rest of the dropped frame has no frame to go to anymore
+  EXPECT_FALSE(add(3));
+  EXPECT_FALSE(add(4));
+  EXPECT_EQ(assembler_.orphan_segments(), 3u);
+  EXPECT_EQ(assembler_.complete_frames(), 0u);
+}
+
+TEST_F(FrameAssemblerTest, SegmentsBeforeTheFirstAreOrphans)
+{
+  EXPECT_FALSE(add(3));
+  EXPECT_FALSE(add(4));
+  EXPECT_EQ(assembler_.orphan_segments(), 2u);
+  EXPECT_FALSE(add(1));
+  EXPECT_FALSE(add(2));
+  EXPECT_FALSE(add(3));
+  EXPECT_TRUE(add(4));
+  EXPECT_EQ(assembler_.complete_frames(), 1u);
+  EXPECT_EQ(assembler_.incomplete_frames(), 0u);
+}
+
+TEST_F(FrameAssemblerTest, NewFirstSegmentDropsTheIncompleteFrame)
+{
+  EXPECT_FALSE(add(1, 10));
+  EXPECT_FALSE(add(2));
+  EXPECT_FALSE(add(1, 20));
+  EXPECT_EQ(assembler_.incomplete_frames(), 1u);
+  EXPECT_FALSE(add(2));
+  EXPECT_FALSE(add(3));
+  EXPECT_TRUE(add(4));
+  EXPECT_EQ(frame_.stamp_ns, 20);
+  EXPECT_EQ(assembler_.complete_frames(), 1u);
+}
+
+TEST_F(FrameAssemblerTest, TimeoutDropsTheFrame)
+{
+  EXPECT_FALSE(add(1, 0));
+  EXPECT_FALSE(add(2, kTimeoutNs));
+  EXPECT_FALSE(add(3, kTimeoutNs + 1));
+  EXPECT_EQ(assembler_.incomplete_frames(), 1u);
+  EXPECT_EQ(assembler_.orphan_segments(), 1u);
+  EXPECT_FALSE(add(4, kTimeoutNs + 2));
+  EXPECT_EQ(assembler_.complete_frames(), 0u);
+}
+
+TEST_F(FrameAssemblerTest, RejectsInvalidSegments)
+{
+  auto segment = make_segment(geometry_, 1, 0);
+  EXPECT_FALSE(assembler_.add(segment.data(), geometry_.segment_bytes() - 1, 0, 0, frame_));
+  segment[20 * kPacketBytes] = 0x0F;  // Discard packet
+  EXPECT_FALSE(assembler_.add(segment.data(), geometry_.segment_bytes(), 0, 0, frame_));
+  segment = make_segment(geometry_, 5, 0);
+  EXPECT_FALSE(assembler_.add(segment.data(), geometry_.segment_bytes(), 0, 0, frame_));
+  segment = make_segment(geometry_, 1, 0);
+  segment[20 * kPacketBytes + 1] = 21;  // Packet number other than 20
+  EXPECT_FALSE(assembler_.add(segment.data(), geometry_.segment_bytes(), 0, 0, frame_));
+  EXPECT_EQ(assembler_.invalid_segments(), 4u);
+  EXPECT_EQ(assembler_.orphan_segments(), 0u);
+}
+
+TEST_F(FrameAssemblerTest, ResetDropsThePartialFrame)
+{
+  EXPECT_FALSE(add(1));
+  EXPECT_FALSE(add(2));
+  assembler_.reset();
+  EXPECT_FALSE(add(3));
+  EXPECT_EQ(assembler_.orphan_segments(), 1u);
+}
+
+TEST(FrameAssembler, UnsegmentedFramesCompleteWithEveryDatagram)
+{
+  const std::size_t lepton2 = 3;
+  const SensorGeometry & geometry = kSensorGeometries[lepton2];
+  ASSERT_EQ(geometry.segments, 1u);
+  FrameAssembler assembler(kTimeoutNs, lepton2);
+  Frame frame;
+  const auto segment = make_segment(geometry, 0, 7);
+  EXPECT_TRUE(assembler.add(segment.data(), geometry.segment_bytes(), 0, 0, frame));
+  EXPECT_TRUE(assembler.add(segment.data(), geometry.segment_bytes(), 0, 0, frame));
+  EXPECT_EQ(assembler.complete_frames(), 2u);
+  EXPECT_EQ(frame.geometry, lepton2);
+}
+
+}  // namespace thermal_network
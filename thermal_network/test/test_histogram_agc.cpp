@@ -0,0 +1,113 @@
+/// \file Histogram AGC tests
+/// \brief Tables HistogramAgc builds, and its incremental histogram against a fresh one
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "thermal_network/frame_decoder.hpp"
+#include "thermal_network/histogram_agc.hpp"
+
+namespace thermal_network
+{
+
+namespace
+{
+/// \brief Full size frame with value(i) at pixel i
+template<typename Value>
+RawFrame make_frame(Value value)
+{
+  RawFrame raw;
+  for (std::size_t i = 0; i < raw.size(); ++i) {
+    raw.pixels[i] = static_cast<uint16_t>(value(i));
+  }
+  update_range(raw);
+  return raw;
+}
+}  // namespace
+
+TEST(HistogramAgc, TwoLevelsMapToBothEndsOfThePalette)
+{
+  const RawFrame raw = make_frame([](std::size_t i) {return i % 2 ? 30100 : 30000;});
+  HistogramAgc agc;
+  uint16_t first;
+  std::vector<uint8_t> index;
+  agc.equalize(raw, first, index);
+  EXPECT_EQ(first, 30000);
+  ASSERT_EQ(index.size(), 101u);
+  EXPECT_EQ(index.front(), 0);
+  EXPECT_EQ(index.back(), 255);
+  // No pixel lies in between, so those values stay at the lower level
+  EXPECT_EQ(index[50], 0);
+}
+
+TEST(HistogramAgc, TableIsMonotonic)
+{
+  uint32_t seed = 1;
+  const RawFrame raw = make_frame(
+    [&seed](std::size_t) {
+      seed = seed * 1664525u + 1013904223u;
+      return 29000 + (seed >> 22);
+    });
+  HistogramAgc agc;
+  uint16_t first;
+  std::vector<uint8_t> index;
+  agc.equalize(raw, first, index);
+  ASSERT_FALSE(index.empty());
+  EXPECT_EQ(first, raw.min);
+  EXPECT_EQ(first + index.size() - 1, raw.max);
+  for (std::size_t v = 1; v < index.size(); ++v) {
+    EXPECT_LE(index[v - 1], index[v]) << "at raw value " << first + v;
+  }
+  EXPECT_EQ(index.back(), 255);
+}
+
+TEST(HistogramAgc, ClippingCutsOffAHotPixel)
+{
+  // A ramp over 100 values and one pixel far above it
+  const RawFrame raw = make_frame(
+    [](std::size_t i) {return i == 0 ? 40000 : 30000 + i % 100;});
+  HistogramAgc agc(0.5);
+  uint16_t first;
+  std::vector<uint8_t> index;
+  agc.equalize(raw, first, index);
+  EXPECT_GE(first, 30000);
+  EXPECT_LT(first + index.size() - 1, 30100u);
+
+  // Without clipping the same pixel stretches the table all the way up
+  HistogramAgc unclipped;
+  unclipped.equalize(raw, first, index);
+  EXPECT_EQ(first + index.size() - 1, 40000u);
+  // But by rank the ramp still spreads over nearly the whole palette
+  EXPECT_GE(index[99], 250);
+}
+
+TEST(HistogramAgc, IncrementalHistogramMatchesAFreshOne)
+{
+  uint32_t seed = 7;
+  auto noise = [&seed](uint16_t base) {
+      return [&seed, base](std::size_t i) {
+               seed = seed * 1664525u + 1013904223u;
+               return base + i % 160 + (seed >> 27);
+             };
+    };
+  const RawFrame before = make_frame(noise(29500));
+  const RawFrame after = make_frame(noise(30500));
+
+  HistogramAgc incremental(1.0);
+  uint16_t first;
+  std::vector<uint8_t> index;
+  incremental.equalize(before, first, index);
+  incremental.equalize(after, first, index);
+
+  HistogramAgc fresh(1.0);
+  uint16_t fresh_first;
+  std::vector<uint8_t> fresh_index;
+  fresh.equalize(after, fresh_first, fresh_index);
+
+  EXPECT_EQ(first, fresh_first);
+  EXPECT_EQ(index, fresh_index);
+}
+
+}  // namespace thermal_network
@@ -0,0 +1,297 @@
+/// \file Image compression tests
+/// \brief Round trips of the encoded images through decoders written from the PNG and QOI
+/// specifications
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "thermal_network/colormap.hpp"
+#include "thermal_network/image_encoder.hpp"
+
+namespace thermal_network
+{
+
+namespace
+{
+constexpr std::size_t kWidth = 160;
+constexpr std::size_t kHeight = 120;
+
+/// \brief Decoded image, RGB8
+struct Image
+{
+  std::size_t width = 0;
+  std::size_t height = 0;
+  std::vector<uint8_t> rgb;
+};
+
+uint32_t get_u32(const uint8_t * data)
+{
+  return static_cast<uint32_t>(data[0]) << 24 | data[1] << 16 | data[2] << 8 | data[3];
+}
+
+/// \brief Decodes an 8 bit palette PNG, checking every chunk CRC
+bool decode_png(const std::vector<uint8_t> & png, Image & image)
+{
+  static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  if (png.size() < 8 || memcmp(png.data(), kSignature, 8) != 0) {
+    return false;
+  }
+  std::vector<uint8_t> palette;
+  std::vector<uint8_t> packed;
+  bool ended = false;
+  for (std::size_t offset = 8; offset + 12 <= png.size() && !ended; ) {
+    const uint32_t size = get_u32(&png[offset]);
+    if (offset + 12 + size > png.size()) {
+      return false;
+    }
+    const uint8_t * type = &png[offset + 4];
+    const uint8_t * data = type + 4;
+    if (crc32(0, type, size + 4) != get_u32(data + size)) {
+      return false;
+    }
+    if (memcmp(type, "IHDR", 4) == 0) {
+      // 8 bit, palette, deflate, adaptive filtering, no interlace
+      if (size != 13 || data[8] != 8 || data[9] != 3 || data[10] != 0 || data[11] != 0 ||
+        data[12] != 0)
+      {
+        return false;
+      }
+      image.width = get_u32(data);
+      image.height = get_u32(data + 4);
+    } else if (memcmp(type, "PLTE", 4) == 0) {
+      palette.assign(data, data + size);
+    } else if (memcmp(type, "IDAT", 4) == 0) {
+      packed.insert(packed.end(), data, data + size);
+    } else if (memcmp(type, "IEND", 4) == 0) {
+      ended = true;
+    }
+    offset += 12 + size;
+  }
+  if (!ended || palette.empty() || palette.size() % 3 != 0) {
+    return false;
+  }
+
+  const std::size_t stride = image.width + 1;
+  std::vector<uint8_t> rows(stride * image.height);
+  uLongf rows_size = rows.size();
+  if (uncompress(rows.data(), &rows_size, packed.data(), packed.size()) != Z_OK ||
+    rows_size != rows.size())
+  {
+    return false;
+  }
+  std::vector<uint8_t> index(image.width * image.height);
+  for (std::size_t y = 0; y < image.height; ++y) {
+    const uint8_t filter = rows[y * stride];
+    const uint8_t * in = &rows[y * stride + 1];
+    uint8_t * out = &index[y * image.width];
+    const uint8_t * up = y > 0 ? out - image.width : nullptr;
+    for (std::size_t x = 0; x < image.width; ++x) {
+      const int a = x > 0 ? out[x - 1] : 0;
+      const int b = up ? up[x] : 0;
+      const int c = x > 0 && up ? up[x - 1] : 0;
+      int predicted = 0;
+      if (filter == 1) {
+        predicted = a;
+      } else if (filter == 2) {
+        predicted = b;
+      } else if (filter == 3) {
+        predicted = (a + b) / 2;
+      } else if (filter == 4) {
+        // Paeth
+        const int p = a + b - c;
+        const int pa = std::abs(p - a);
+        const int pb = std::abs(p - b);
+        const int pc = std::abs(p - c);
+        predicted = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+      } else if (filter != 0) {
+        return false;
+      }
+      out[x] = static_cast<uint8_t>(in[x] + predicted);
+    }
+  }
+  image.rgb.resize(index.size() * 3);
+  for (std::size_t i = 0; i < index.size(); ++i) {
+    if (index[i] * 3u + 3 > palette.size()) {
+      return false;
+    }
+    memcpy(&image.rgb[i * 3], &palette[index[i] * 3], 3);
+  }
+  return true;
+}
+
+/// \brief Decodes a QOI image like the reference decoder, qoi.h
+bool decode_qoi(const std::vector<uint8_t> & qoi, Image & image)
+{
+  static const uint8_t kEnd[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+  if (qoi.size() < 22 || memcmp(qoi.data(), "qoif", 4) != 0 ||
+    memcmp(&qoi[qoi.size() - 8], kEnd, 8) != 0)
+  {
+    return false;
+  }
+  image.width = get_u32(&qoi[4]);
+  image.height = get_u32(&qoi[8]);
+  if (qoi[12] != 3 && qoi[12] != 4) {
+    return false;
+  }
+  uint8_t seen[64][4] = {};
+  uint8_t pixel[4] = {0, 0, 0, 255};
+  int run = 0;
+  std::size_t p = 14;
+  const std::size_t chunks_end = qoi.size() - 8;
+  image.rgb.resize(image.width * image.height * 3);
+  for (std::size_t i = 0; i < image.width * image.height; ++i) {
+    if (run > 0) {
+      run--;
+    } else if (p < chunks_end) {
+      const int b1 = qoi[p++];
+      if (b1 == 0xFE) {
+        pixel[0] = qoi[p++];
+        pixel[1] = qoi[p++];
+        pixel[2] = qoi[p++];
+      } else if (b1 == 0xFF) {
+        memcpy(pixel, &qoi[p], 4);
+        p += 4;
+      } else if ((b1 & 0xC0) == 0x00) {
+        memcpy(pixel, seen[b1], 4);
+      } else if ((b1 & 0xC0) == 0x40) {
+        pixel[0] += ((b1 >> 4) & 0x03) - 2;
+        pixel[1] += ((b1 >> 2) & 0x03) - 2;
+        pixel[2] += (b1 & 0x03) - 2;
+      } else if ((b1 & 0xC0) == 0x80) {
+        const int b2 = qoi[p++];
+        const int dg = (b1 & 0x3F) - 32;
+        pixel[0] += dg - 8 + ((b2 >> 4) & 0x0F);
+        pixel[1] += dg;
+        pixel[2] += dg - 8 + (b2 & 0x0F);
+      } else {
+        run = b1 & 0x3F;
+      }
+      memcpy(seen[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+    } else {
+      return false;
+    }
+    if (pixel[3] != 255) {
+      return false;
+    }
+    memcpy(&image.rgb[i * 3], pixel, 3);
+  }
+  return p == chunks_end;
+}
+
+/// \brief Palette indices of the scenes the encoders are checked with
+std::vector<uint8_t> make_index(int scene)
+{
+  std::vector<uint8_t> index(kWidth * kHeight);
+  uint32_t seed = 1;
+  for (std::size_t i = 0; i < index.size(); ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    if (scene == 0) {
+      // Black in grayscale right after another color, QOI has not stored it in its index yet
+      index[i] = i == 0 ? 100 : 0;
+    } else if (scene == 1) {
+      index[i] = i % 256;
+    } else if (scene == 2) {
+      index[i] = seed >> 24;
+    } else {
+      // Runs broken up by noise
+      index[i] = (seed >> 29) ? 0 : seed >> 16;
+    }
+  }
+  return index;
+}
+
+void expect_image(
+  const Image & image, const std::vector<uint8_t> & index, const PaletteColors & colors)
+{
+  ASSERT_EQ(image.width, kWidth);
+  ASSERT_EQ(image.height, kHeight);
+  ASSERT_EQ(image.rgb.size(), index.size() * 3);
+  for (std::size_t i = 0; i < index.size(); ++i) {
+    ASSERT_EQ(memcmp(&image.rgb[i * 3], &colors[index[i] * 3], 3), 0) << "at pixel " << i;
+  }
+}
+
+class ImageEncoderTest : public ::testing::TestWithParam<std::tuple<Palette, int>>
+{
+};
+}  // namespace
+
+TEST_P(ImageEncoderTest, PngRoundTrip)
+{
+  const PaletteColors & colors = palette_colors(std::get<0>(GetParam()));
+  const std::vector<uint8_t> index = make_index(std::get<1>(GetParam()));
+  std::vector<uint8_t> png;
+  ASSERT_TRUE(encode_image(ImageCodec::kPng, index.data(), kWidth, kHeight, colors, 6, png));
+  Image image;
+  ASSERT_TRUE(decode_png(png, image));
+  expect_image(image, index, colors);
+}
+
+TEST_P(ImageEncoderTest, QoiRoundTrip)
+{
+  const PaletteColors & colors = palette_colors(std::get<0>(GetParam()));
+  const std::vector<uint8_t> index = make_index(std::get<1>(GetParam()));
+  std::vector<uint8_t> qoi;
+  ASSERT_TRUE(encode_image(ImageCodec::kQoi, index.data(), kWidth, kHeight, colors, 0, qoi));
+  Image image;
+  ASSERT_TRUE(decode_qoi(qoi, image));
+  expect_image(image, index, colors);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  PalettesAndScenes, ImageEncoderTest,
+  ::testing::Combine(
+    ::testing::Values(Palette::kIronblack, Palette::kRainbow, Palette::kGrayscale),
+    ::testing::Values(0, 1, 2, 3)));
+
+#ifdef THERMAL_NETWORK_HAS_JPEG
+TEST(ImageEncoder, JpegIsAFramedImage)
+{
+  const std::vector<uint8_t> index = make_index(2);
+  std::vector<uint8_t> jpeg;
+  ASSERT_TRUE(
+    encode_image(
+      ImageCodec::kJpeg, index.data(), kWidth, kHeight, palette_colors(Palette::kIronblack), 90,
+      jpeg));
+  ASSERT_GT(jpeg.size(), 4u);
+  EXPECT_EQ(jpeg[0], 0xFF);
+  EXPECT_EQ(jpeg[1], 0xD8);
+  EXPECT_EQ(jpeg[jpeg.size() - 2], 0xFF);
+  EXPECT_EQ(jpeg[jpeg.size() - 1], 0xD9);
+}
+
+TEST(ImageEncoder, JpegFailureIsReported)
+{
+  const std::vector<uint8_t> index = make_index(0);
+  std::vector<uint8_t> jpeg;
+  EXPECT_FALSE(
+    encode_image(
+      ImageCodec::kJpeg, index.data(), 0, kHeight, palette_colors(Palette::kIronblack), 90,
+      jpeg));
+}
+#endif
+
+TEST(ImageEncoder, ParsesTheCodecNames)
+{
+  ImageCodec codec;
+  EXPECT_TRUE(parse_image_codec("png", codec));
+  EXPECT_EQ(codec, ImageCodec::kPng);
+  EXPECT_TRUE(parse_image_codec("qoi", codec));
+  EXPECT_EQ(codec, ImageCodec::kQoi);
+  EXPECT_FALSE(parse_image_codec("bmp", codec));
+}
+
+TEST(ImageEncoder, FormatsFollowImageTransport)
+{
+  EXPECT_STREQ(compressed_image_format(ImageCodec::kPng), "rgb8; png compressed rgb8");
+  EXPECT_STREQ(compressed_image_format(ImageCodec::kJpeg), "rgb8; jpeg compressed rgb8");
+  EXPECT_STREQ(compressed_image_format(ImageCodec::kQoi), "rgb8; qoi compressed rgb8");
+}
+
+}  // namespace thermal_network
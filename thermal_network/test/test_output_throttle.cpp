@@ -0,0 +1,84 @@
+/// \file Output rate limiting tests
+/// \brief Decimation and rate bound of OutputThrottle
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "thermal_network/output_throttle.hpp"
+
+namespace thermal_network
+{
+
+namespace
+{
+/// \brief Lepton 3 frame period, about 8.7 Hz
+constexpr int64_t kFramePeriodNs = 115000000;
+constexpr int64_t kSecondNs = 1000000000;
+}  // namespace
+
+TEST(OutputThrottle, DefaultAcceptsEveryFrame)
+{
+  OutputThrottle throttle;
+  for (int64_t i = 0; i < 100; ++i) {
+    EXPECT_TRUE(throttle.accept(i));
+  }
+}
+
+TEST(OutputThrottle, DecimationAcceptsOneFrameOutOfN)
+{
+  OutputThrottle throttle(3);
+  for (int64_t i = 0; i < 30; ++i) {
+    EXPECT_EQ(throttle.accept(i * kFramePeriodNs), i % 3 == 0) << "frame " << i;
+  }
+}
+
+TEST(OutputThrottle, InvalidDecimationAcceptsEveryFrame)
+{
+  OutputThrottle throttle(0);
+  for (int64_t i = 0; i < 10; ++i) {
+    EXPECT_TRUE(throttle.accept(i));
+  }
+}
+
+TEST(OutputThrottle, MaxRateBoundsTheAverageRate)
+{
+  // 2 Hz out of 8.7 Hz cannot be met by decimation, only the deadlines get it right on average
+  OutputThrottle throttle(1, 2.0);
+  int accepted = 0;
+  int64_t now_ns = 0;
+  for (; now_ns < 60 * kSecondNs; now_ns += kFramePeriodNs) {
+    accepted += throttle.accept(now_ns);
+  }
+  EXPECT_GE(accepted, 119);
+  EXPECT_LE(accepted, 121);
+}
+
+TEST(OutputThrottle, PauseCausesNoBurst)
+{
+  OutputThrottle throttle(1, 2.0);
+  EXPECT_TRUE(throttle.accept(0));
+  // Frames resume after ten seconds, the missed deadlines are not made up for
+  int64_t now_ns = 10 * kSecondNs;
+  EXPECT_TRUE(throttle.accept(now_ns));
+  int accepted = 0;
+  for (int i = 0; i < 8; ++i) {
+    now_ns += kFramePeriodNs;
+    accepted += throttle.accept(now_ns);
+  }
+  EXPECT_LE(accepted, 2);
+}
+
+TEST(OutputThrottle, DecimationAppliesBeforeTheRate)
+{
+  OutputThrottle throttle(2, 1.0);
+  // Every other frame is offered to the rate bound, which then takes one per second
+  int accepted = 0;
+  for (int64_t now_ns = 0; now_ns < 10 * kSecondNs; now_ns += kFramePeriodNs) {
+    accepted += throttle.accept(now_ns);
+  }
+  EXPECT_GE(accepted, 9);
+  EXPECT_LE(accepted, 11);
+}
+
+}  // namespace thermal_network
@@ -0,0 +1,117 @@
+/// \file Frame queue tests
+/// \brief Drop policies of SpscFrameQueue, and the drop_oldest steal racing the consumer
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "thermal_network/spsc_frame_queue.hpp"
+
+namespace thermal_network
+{
+
+TEST(SpscFrameQueue, HandsOutFramesInOrder)
+{
+  SpscFrameQueue<int> queue(4, DropPolicy::kDropOldest);
+  EXPECT_EQ(queue.pop(), nullptr);
+  for (int i = 1; i <= 3; ++i) {
+    queue.producer_buffer() = i;
+    EXPECT_TRUE(queue.push());
+  }
+  for (int i = 1; i <= 3; ++i) {
+    const int * frame = queue.pop();
+    ASSERT_NE(frame, nullptr);
+    EXPECT_EQ(*frame, i);
+  }
+  EXPECT_EQ(queue.pop(), nullptr);
+  EXPECT_EQ(queue.dropped(), 0u);
+}
+
+TEST(SpscFrameQueue, DropOldestStealsTheOldestQueuedFrame)
+{
+  SpscFrameQueue<int> queue(2, DropPolicy::kDropOldest);
+  queue.producer_buffer() = 1;
+  EXPECT_TRUE(queue.push());
+  queue.producer_buffer() = 2;
+  EXPECT_TRUE(queue.push());
+  EXPECT_TRUE(queue.full());
+  queue.producer_buffer() = 3;
+  EXPECT_FALSE(queue.push());
+  EXPECT_EQ(queue.dropped(), 1u);
+  // The stolen buffer is filled next and has to replace frame 1 without touching the others
+  queue.producer_buffer() = 4;
+  EXPECT_FALSE(queue.push());
+  EXPECT_EQ(queue.dropped(), 2u);
+  const int * frame = queue.pop();
+  ASSERT_NE(frame, nullptr);
+  EXPECT_EQ(*frame, 3);
+  frame = queue.pop();
+  ASSERT_NE(frame, nullptr);
+  EXPECT_EQ(*frame, 4);
+  EXPECT_EQ(queue.pop(), nullptr);
+}
+
+TEST(SpscFrameQueue, DropNewestKeepsTheQueuedFrames)
+{
+  SpscFrameQueue<int> queue(2, DropPolicy::kDropNewest);
+  queue.producer_buffer() = 1;
+  EXPECT_TRUE(queue.push());
+  queue.producer_buffer() = 2;
+  EXPECT_TRUE(queue.push());
+  queue.producer_buffer() = 3;
+  EXPECT_FALSE(queue.push());
+  EXPECT_EQ(queue.dropped(), 1u);
+  const int * frame = queue.pop();
+  ASSERT_NE(frame, nullptr);
+  EXPECT_EQ(*frame, 1);
+  // The dropped frame's buffer was kept by the producer and goes out with the next push
+  EXPECT_EQ(queue.producer_buffer(), 3);
+  EXPECT_TRUE(queue.push());
+  frame = queue.pop();
+  ASSERT_NE(frame, nullptr);
+  EXPECT_EQ(*frame, 2);
+  frame = queue.pop();
+  ASSERT_NE(frame, nullptr);
+  EXPECT_EQ(*frame, 3);
+}
+
+TEST(SpscFrameQueue, StealRacingTheConsumerLosesNoFrameAndDuplicatesNone)
+{
+  constexpr uint64_t kFrames = 200000;
+  SpscFrameQueue<uint64_t> queue(2, DropPolicy::kDropOldest);
+  std::atomic<bool> done{false};
+  uint64_t received = 0;
+  uint64_t last = 0;
+  bool ordered = true;
+
+  std::thread consumer([&]() {
+      for (;;) {
+        const bool finished = done.load(std::memory_order_acquire);
+        const uint64_t * frame = queue.pop();
+        if (frame == nullptr) {
+          if (finished) {
+            break;
+          }
+          continue;
+        }
+        ordered = ordered && *frame > last;
+        last = *frame;
+        received++;
+      }
+    });
+  for (uint64_t i = 1; i <= kFrames; ++i) {
+    queue.producer_buffer() = i;
+    queue.push();
+  }
+  done.store(true, std::memory_order_release);
+  consumer.join();
+
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(received + queue.dropped(), kFrames);
+  // The last frame can only have been stolen by a later push, and there is none
+  EXPECT_EQ(last, kFrames);
+}
+
+}  // namespace thermal_network